@@ -4,8 +4,50 @@
 #include <algorithm>
 #include <string>
 #include <exception>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <string_view>
+#include <unordered_map>
+#include <stdexcept>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <random>
+#include <cstdint>
+#include <climits>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <future>
+#include <optional>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <cassert>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#endif
+#include <functional>
+#include <filesystem>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 using namespace std;
 
+//memory accounting used by the Prototype and Flyweight benchmarks: heap bytes owned by a string
+inline size_t heapBytes(const string& s){ //0 when the characters live inside the string object (small string optimization, whatever its threshold)
+    const char* d = s.data();
+    const char* self = reinterpret_cast<const char*>(&s);
+    return d >= self && d < self + sizeof(string) ? 0 : s.capacity() + 1;
+}
+
 
 //Design Patterns are reusable, general and typical solutions to recurring problems in object-oriented system design (design problems)
 
@@ -19,22 +61,27 @@ using namespace std;
 class Singleton{
     private:
         static Singleton* instance; 
+        static once_flag created; //guards the one-time construction of instance across threads
         Singleton(){}; //private constructor to prevent creating an object in main()
+
+        static Singleton* createInstance(){
+            call_once(created, [](){ instance = new Singleton; }); //only one thread runs the lambda, the others block until it is done (no race, no half-built object)
+            return instance;
+        }
     public:
+        Singleton(const Singleton&) = delete; //copying would create a second instance
+        Singleton& operator=(const Singleton&) = delete;
+
         static Singleton& getInstance(){
-            if (instance == nullptr){
-                instance = new Singleton;
-                return *instance;     
-            }
-            return *instance; 
+            return *getPtrInstance(); 
         }
 
         static Singleton* getPtrInstance(){
-            if (instance == nullptr){
-                instance = new Singleton;
-                return instance;     
+            thread_local Singleton* cached = nullptr; //per-thread fast path: after the first call a thread only reads its own copy of the pointer (no shared cache line, no mutex)
+            if (cached == nullptr){
+                cached = createInstance();
             }
-            return instance; 
+            return cached; 
         }
 
         void show(){
@@ -45,6 +92,51 @@ class Singleton{
 
 
 Singleton* Singleton::instance = nullptr;
+once_flag Singleton::created;
+
+//Eager Singleton: the instance is built during static initialization (before main) so no call ever pays for the lazy construction -> beware of the static initialization order between translation units
+class EagerSingleton{
+    private:
+        static EagerSingleton instance;
+        EagerSingleton(){};
+    public:
+        EagerSingleton(const EagerSingleton&) = delete;
+        EagerSingleton& operator=(const EagerSingleton&) = delete;
+
+        static EagerSingleton& getInstance(){
+            return instance;
+        }
+};
+
+EagerSingleton EagerSingleton::instance;
+
+//microbenchmark: N threads call getInstance in a loop -> the time per call should stay flat as N grows (no cache-line ping-pong on the shared instance pointer)
+template<typename S>
+double benchGetInstance(int nThreads, long callsPerThread){
+    struct alignas(64) Slot{ uintptr_t sink = 0; }; //one cache line per thread so the benchmark itself doesn't false-share
+    vector<Slot> slots(nThreads);
+    vector<thread> threads;
+    auto start = chrono::steady_clock::now();
+    for (int k = 0; k < nThreads; k++){
+        threads.emplace_back([&slots, k, callsPerThread](){
+            uintptr_t sink = 0;
+            for (long i = 0; i < callsPerThread; i++){
+                sink ^= reinterpret_cast<uintptr_t>(&S::getInstance()) + i;
+            }
+            slots[k].sink = sink;
+        });
+    }
+    for (thread& th: threads) th.join();
+    auto elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    return elapsed / callsPerThread; //ns per call (per thread, threads run in parallel)
+}
+
+void benchSingleton(long callsPerThread){
+    int maxThreads = max(1u, thread::hardware_concurrency());
+    for (int n = 1; n <= maxThreads; n *= 2){
+        cout << n << " threads: lazy " << benchGetInstance<Singleton>(n, callsPerThread) << " ns/call, eager " << benchGetInstance<EagerSingleton>(n, callsPerThread) << " ns/call\n";
+    }
+}
 
 
 int main(){
@@ -55,6 +147,10 @@ int main(){
     Singleton* ap = Singleton::getPtrInstance();
     Singleton* bp = Singleton::getPtrInstance();
 
+    EagerSingleton& e = EagerSingleton::getInstance(); //already built before main
+    cout << (&e == &EagerSingleton::getInstance()) << "\n"; //1: every call returns the same instance
+
+    benchSingleton(10000000);
 };
 
 //Factory Method: Object creation depend on conditions like a factory of products of different types
@@ -63,6 +159,7 @@ int main(){
 class Animal {
 public:
     virtual void speak() = 0;
+    virtual ~Animal() = default;
 };
 
 class Dog : public Animal {
@@ -79,15 +176,72 @@ public:
     }
 };
 
+//type tags are hashed once (at compile time for literals) into an interned type ID -> the factory dispatches on the ID in O(1) instead of comparing strings
+struct AnimalTypeId{
+    uint64_t value;
+};
+
+constexpr AnimalTypeId animalTypeId(string_view type){ //FNV-1a
+    uint64_t h = 14695981039346656037ull;
+    for (char c: type){
+        h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    return AnimalTypeId{h};
+}
+
 class AnimalFactory{
+    using Creator = Animal* (*)();
+    struct Entry{
+        string type; //kept to detect hash collisions (at registration and on lookups by tag)
+        Creator create;
+    };
+    struct IdHash{ //the key is already a hash
+        size_t operator()(uint64_t id) const noexcept { return static_cast<size_t>(id); }
+    };
+
+    static unordered_map<uint64_t, Entry, IdHash>& registry(){ //function-local static: safe to use from other static initializers (self-registration)
+        static unordered_map<uint64_t, Entry, IdHash> r;
+        return r;
+    }
     public:
-        static Animal* createAnimal(string type){
-            if (type == "Dog") return new Dog; 
-            if (type == "Cat") return new Cat;
-            return nullptr; 
+        //registry: new Animal subclasses plug themselves in without editing the factory (Open-Closed principle)
+        static void registerAnimal(string_view type, Creator create){
+            uint64_t id = animalTypeId(type).value;
+            auto it = registry().find(id);
+            if (it != registry().end() && it->second.type != type){
+                throw invalid_argument("Animal type hash collision: " + string(type));
+            }
+            registry()[id] = Entry{string(type), create};
+        }
+
+        static Animal* createAnimal(AnimalTypeId id){ //runtime path: one hash lookup; the id is trusted, so it must come from a registered tag (an unregistered tag could collide)
+            auto it = registry().find(id.value);
+            if (it == registry().end()) return nullptr;
+            return it->second.create();
+        }
+
+        static Animal* createAnimal(string_view type){ //no string copy, the tag is hashed in place; one compare rejects an unregistered tag that collides with a registered one
+            auto it = registry().find(animalTypeId(type).value);
+            if (it == registry().end() || it->second.type != type) return nullptr;
+            return it->second.create();
+        }
+
+        template<typename T>
+        static T* createAnimal(){ //compile-time path: the type is known statically so no lookup at all
+            return new T;
         }
 }; 
 
+template<typename T>
+struct AnimalRegistrar{ //a static AnimalRegistrar<T> object registers T before main() runs
+    explicit AnimalRegistrar(string_view type){
+        AnimalFactory::registerAnimal(type, []() -> Animal* { return new T; });
+    }
+};
+
+static AnimalRegistrar<Dog> dogRegistrar("Dog");
+static AnimalRegistrar<Cat> catRegistrar("Cat");
+
 int main(){
     Animal* ad = AnimalFactory::createAnimal("Dog");   //dynamic type is Dog 
     Animal* ac = AnimalFactory::createAnimal("Cat");   //dynamic type is Cat
@@ -95,15 +249,22 @@ int main(){
 
     ad->speak(); //woof
     ac->speak(); //meow
+
+    constexpr AnimalTypeId dogId = animalTypeId("Dog"); //interned once, reused for millions of creations
+    Animal* ad2 = AnimalFactory::createAnimal(dogId);
+    Dog* d = AnimalFactory::createAnimal<Dog>(); //static type is Dog, no dispatch
+
+    delete ad; delete ac; delete ad2; delete d;
 }
 
 class Transport{ //interface
     public:
         virtual void drive() = 0;
+        virtual int getCapacity() const { return 0; } //not pure: existing transports that do not track a capacity still compile
         virtual ~Transport() = default;
 };
 
-class Truck: public Transport{
+class Truck final: public Transport{ //final: calls through a Truck& can be devirtualized by the compiler
     int capacity; 
     public:
         Truck(int c): capacity(c){}
@@ -111,11 +272,15 @@ class Truck: public Transport{
         void drive() override{
             cout << "Truck transport!";
         }
+
+        int getCapacity() const override{
+            return capacity;
+        }
         
 };
 
 
-class Ship: public Transport{
+class Ship final: public Transport{
     int capacity; 
     public:
         Ship(int c): capacity(c){}
@@ -123,28 +288,230 @@ class Ship: public Transport{
         void drive() override{
             cout << "Ship transport!";
         }
+
+        int getCapacity() const override{
+            return capacity;
+        }
         
 };
 
+//Poly collection: instead of vector<Transport*> (one pointer chase + one virtual call per element), keep one contiguous vector per concrete type and loop over each vector with the static type known
+///callers that need runtime polymorphism still get a Transport& from forEach, the Transport interface is unchanged
+///inserting may reallocate a segment: references to elements are invalidated like in a vector
+template<typename... Ts>
+class TransportCollection{
+    static_assert((is_base_of<Transport, Ts>::value && ...), "segments must hold Transport subclasses");
+    tuple<vector<Ts>...> segments;
+    public:
+        template<typename T, typename... Args>
+        T& emplace(Args&&... args){
+            return get<vector<T>>(segments).emplace_back(std::forward<Args>(args)...);
+        }
+
+        template<typename T>
+        vector<T>& segment(){
+            return get<vector<T>>(segments);
+        }
+
+        template<typename F>
+        void forEach(F f){ //f is instantiated once per concrete type -> the call inside f is resolved at compile time
+            (forEachIn<Ts>(f), ...);
+        }
+
+        void driveAll(){
+            forEach([](auto& t){
+                using T = decay_t<decltype(t)>;
+                t.T::drive(); //qualified call: no virtual dispatch
+            });
+        }
+
+        size_t size() const {
+            return (get<vector<Ts>>(segments).size() + ...);
+        }
+
+        void clear(){
+            (get<vector<Ts>>(segments).clear(), ...);
+        }
+    private:
+        template<typename T, typename F>
+        void forEachIn(F& f){
+            for (T& t: get<vector<T>>(segments)) f(t);
+        }
+};
+
+//benchmark: total fleet capacity over n transports stored as vector<Transport*> vs the poly collection
+void benchTransportCollection(long n){
+    vector<Transport*> pointers;
+    TransportCollection<Truck, Ship> fleet;
+    pointers.reserve(n);
+    for (long i = 0; i < n; i++){
+        int capacity = static_cast<int>(i % 100);
+        if (i % 3){
+            pointers.push_back(new Truck(capacity));
+            fleet.emplace<Truck>(capacity);
+        } else {
+            pointers.push_back(new Ship(capacity));
+            fleet.emplace<Ship>(capacity);
+        }
+    }
+    shuffle(pointers.begin(), pointers.end(), default_random_engine(42)); //a long-lived fleet ends up in random heap/type order
+
+    auto start = chrono::steady_clock::now();
+    long pointerTotal = 0;
+    for (Transport* t: pointers) pointerTotal += t->getCapacity();
+    auto middle = chrono::steady_clock::now();
+    long fleetTotal = 0;
+    fleet.forEach([&fleetTotal](auto& t){ fleetTotal += t.getCapacity(); });
+    auto end = chrono::steady_clock::now();
+
+    cout << n << " transports: vector<Transport*> " << chrono::duration<double, milli>(middle - start).count() << " ms, poly collection " << chrono::duration<double, milli>(end - middle).count() << " ms (" << pointerTotal << " == " << fleetTotal << ")\n";
+    for (Transport* t: pointers) delete t;
+}
+
+//Arena allocation: a fleet simulator creates and drops a huge number of short-lived products per tick -> instead of one malloc per product, carve them out of large blocks (bump pointer) and release the whole tick at once
+class TransportArena{
+    vector<unique_ptr<char[]>> blocks;
+    vector<unique_ptr<char[]>> oversize; //products larger than a block get their own allocation, freed on reset
+    vector<Transport*> objects; //destructors to run on reset
+    size_t blockSize;
+    size_t used; //bump offset in the last block
+    size_t current; //index of the block being filled
+    public:
+        explicit TransportArena(size_t bs = 1 << 20): blockSize(bs), used(0), current(0){
+            blocks.push_back(make_unique<char[]>(blockSize));
+        }
+        TransportArena(const TransportArena&) = delete;
+        TransportArena& operator=(const TransportArena&) = delete;
+
+        //the arena owns the product until reset() or the arena's destruction: the pointer is a non-owning reference, valid until then
+        ///deliberately not an owning handle: a handle that releases on destruction would bring back the per-product release the arena exists to avoid
+        template<typename T, typename... Args>
+        T* create(Args&&... args){
+            static_assert(is_base_of<Transport, T>::value, "arena only holds Transport products");
+            static_assert(alignof(T) <= alignof(max_align_t), "unsupported product alignment");
+            if (sizeof(T) > blockSize){ //would not fit even in an empty block
+                oversize.push_back(make_unique<char[]>(sizeof(T)));
+                T* p = new (oversize.back().get()) T(std::forward<Args>(args)...);
+                objects.push_back(p);
+                return p;
+            }
+            size_t offset = (used + alignof(T) - 1) & ~(alignof(T) - 1);
+            if (offset + sizeof(T) > blockSize){ //block full: move to the next one (kept from previous ticks) or allocate it
+                current++;
+                if (current == blocks.size()) blocks.push_back(make_unique<char[]>(blockSize));
+                offset = 0;
+            }
+            T* p = new (blocks[current].get() + offset) T(std::forward<Args>(args)...);
+            used = offset + sizeof(T);
+            objects.push_back(p);
+            return p;
+        }
+
+        void reset(){ //bulk release at the end of a tick: run the destructors and rewind, the blocks are reused by the next tick
+            for (Transport* t: objects) t->~Transport();
+            objects.clear();
+            oversize.clear();
+            used = 0;
+            current = 0;
+        }
+
+        size_t size() const { return objects.size(); }
+
+        ~TransportArena(){
+            reset();
+        }
+};
+
+//Object pool: one free list per product type, for products that die individually instead of per tick
+template<typename T>
+class TransportPool{
+    union Slot{
+        Slot* next; //free list link while the slot is unused
+        alignas(T) char storage[sizeof(T)];
+    };
+    vector<unique_ptr<Slot[]>> slabs;
+    Slot* freeList = nullptr;
+    size_t slabSize;
+    size_t live = 0; //handles not yet released
+
+    void grow(){
+        slabs.push_back(make_unique<Slot[]>(slabSize));
+        Slot* slab = slabs.back().get();
+        for (size_t k = 0; k < slabSize; k++){
+            slab[k].next = freeList;
+            freeList = &slab[k];
+        }
+    }
+    public:
+        struct Deleter{ //the handle gives the slot back to its pool instead of calling delete
+            TransportPool* pool;
+            void operator()(T* p) const { pool->release(p); }
+        };
+        using Handle = unique_ptr<T, Deleter>; //owning handle: it points back to its pool, so every handle must be destroyed before the pool
+
+        explicit TransportPool(size_t ss = 4096): slabSize(ss){}
+        TransportPool(const TransportPool&) = delete;
+        TransportPool& operator=(const TransportPool&) = delete;
+
+        ~TransportPool(){
+            assert(live == 0 && "TransportPool destroyed while handles are still alive");
+        }
+
+        template<typename... Args>
+        Handle create(Args&&... args){
+            if (freeList == nullptr) grow();
+            Slot* slot = freeList;
+            freeList = slot->next;
+            T* p = new (slot->storage) T(std::forward<Args>(args)...);
+            live++;
+            return Handle(p, Deleter{this});
+        }
+
+        void release(T* p){
+            live--;
+            p->~T();
+            Slot* slot = reinterpret_cast<Slot*>(p);
+            slot->next = freeList;
+            freeList = slot;
+        }
+};
+
 class TransportFactoryInterface{
     public:
         virtual Transport* createTransport(int capacity) = 0; 
+        virtual Transport* createTransport(int capacity, TransportArena& arena) = 0; //allocator-aware: the arena owns the product, the pointer is valid until arena.reset()
         virtual ~TransportFactoryInterface() = default;
 };
 
 class TruckFactory: public TransportFactoryInterface{
     public:
+        using Pool = TransportPool<Truck>;
+
         Transport* createTransport(int capacity) override{
             return new Truck(capacity);
         }
+        Transport* createTransport(int capacity, TransportArena& arena) override{
+            return arena.create<Truck>(capacity);
+        }
+        Pool::Handle createTransport(int capacity, Pool& pool){ //pooled: not virtual, the pool is typed by the concrete product
+            return pool.create(capacity);
+        }
 }; 
 
 
 class ShipFactory: public TransportFactoryInterface{
     public:
+        using Pool = TransportPool<Ship>;
+
         Transport* createTransport(int capacity) override{
             return new Ship(capacity);
         }
+        Transport* createTransport(int capacity, TransportArena& arena) override{
+            return arena.create<Ship>(capacity);
+        }
+        Pool::Handle createTransport(int capacity, Pool& pool){
+            return pool.create(capacity);
+        }
 
 }; 
 
@@ -174,8 +541,62 @@ class TransportFactory{
             }
         }
 
+        static Transport* createStaticTransport(string_view type, int capacity, TransportArena& arena){
+            if (type == "Truck") return arena.create<Truck>(capacity);
+            if (type == "Ship") return arena.create<Ship>(capacity);
+            return nullptr;
+        }
+
 };
 
+//benchmark: n creations with one new/delete per product vs the arena (reset every tick) vs the pool
+void benchTransportAllocation(long n, long perTick){
+    long sink = 0;
+    auto time = [](auto&& f){
+        auto start = chrono::steady_clock::now();
+        f();
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    };
+    double heapMs = time([&](){
+        vector<Transport*> tick;
+        tick.reserve(perTick);
+        for (long i = 0; i < n; i++){
+            tick.push_back(i % 2 ? static_cast<Transport*>(new Truck(20)) : new Ship(20));
+            if (tick.size() == static_cast<size_t>(perTick)){
+                for (Transport* t: tick) delete t;
+                sink += tick.size();
+                tick.clear();
+            }
+        }
+        for (Transport* t: tick) delete t;
+    });
+    double arenaMs = time([&](){
+        TransportArena arena;
+        for (long i = 0; i < n; i++){
+            if (i % 2) arena.create<Truck>(20); else arena.create<Ship>(20);
+            if (arena.size() == static_cast<size_t>(perTick)){
+                sink += arena.size();
+                arena.reset();
+            }
+        }
+    });
+    double poolMs = time([&](){
+        TransportPool<Truck> trucks;
+        TransportPool<Ship> ships;
+        vector<TransportPool<Truck>::Handle> truckTick;
+        vector<TransportPool<Ship>::Handle> shipTick;
+        for (long i = 0; i < n; i++){
+            if (i % 2) truckTick.push_back(trucks.create(20)); else shipTick.push_back(ships.create(20));
+            if (truckTick.size() + shipTick.size() == static_cast<size_t>(perTick)){
+                sink += perTick;
+                truckTick.clear();
+                shipTick.clear();
+            }
+        }
+    });
+    cout << n << " creations: new/delete " << heapMs << " ms, arena " << arenaMs << " ms, pool " << poolMs << " ms (" << sink << ")\n";
+}
+
 int main(){
 
     //Simple Factory
@@ -191,14 +612,47 @@ int main(){
     Transport* ss = TransportFactory::createStaticTransport("Ship", 20); 
     ss->drive(); 
     
-    delete t, s;
+    delete t; //"delete t, s;" only deletes t (comma operator)
+    delete s;
+    delete st;
+    delete ss;
 
     //Factory Method
     TruckFactory tr;
     Transport* tt = tr.createTransport(20); 
 
     ShipFactory sh; 
-    Transport* ss = sh.createTransport(20);
+    Transport* sf = sh.createTransport(20);
+    delete tt;
+    delete sf;
+
+    //Factory Method with an arena: all products of a tick are released together
+    TransportArena arena;
+    for (int tick = 0; tick < 3; tick++){
+        Transport* at = tr.createTransport(20, arena);
+        Transport* as = sh.createTransport(20, arena);
+        at->drive();
+        as->drive();
+        arena.reset(); //end of tick
+    }
+
+    //Factory Method with a pool: owning handles that return their slot to the pool (declared after the pool, so destroyed before it)
+    TruckFactory::Pool truckPool;
+    {
+        TruckFactory::Pool::Handle h = tr.createTransport(20, truckPool);
+        h->drive();
+    } //slot recycled here
+
+    benchTransportAllocation(10000000, 100000);
+
+    //Poly collection: each concrete type stored contiguously by value
+    TransportCollection<Truck, Ship> fleet;
+    fleet.emplace<Truck>(20);
+    fleet.emplace<Ship>(30);
+    fleet.driveAll(); //no virtual dispatch
+    fleet.forEach([](Transport& tr){ tr.drive(); }); //runtime polymorphism still available
+
+    benchTransportCollection(10000000);
     
     return 0;
 }
@@ -212,20 +666,21 @@ class Human {
     public:
         Human(string n): name(n){}
         virtual void reproduce() = 0; 
+        virtual ~Human() = default;
 }; 
 
 class Female: public Human{
     string name;
     public:
         Female(string n): Human(n){}
-        // void reproduce() override {cout <<"Female reproduction";}
+        void reproduce() override {cout <<"Female reproduction";}
 };
 
 class Male: public Human{
     string name;
     public:
         Male(string n): Human(n){}
-        // void reproduce() override{cout <<"Male reproduction";}
+        void reproduce() override{cout <<"Male reproduction";}
 };
 
 class HumanFactory{
@@ -236,23 +691,254 @@ class HumanFactory{
         } 
 };
 
-class AbstractFactory{
-
-};
-
 class Entity{
     int id;
     public:
         Entity(int idd): id(idd){}
 
+        int getId() const {
+            return id;
+        }
+
         virtual void update() = 0; 
+        virtual ~Entity() = default;
+};
+
+//the Entity variants of each family (the simulation counterpart of a Human)
+class MaleAvatar: public Entity{
+    public:
+        MaleAvatar(int id): Entity(id){}
+        void update() override {cout << "Male avatar updated";}
+};
+
+class FemaleAvatar: public Entity{
+    public:
+        FemaleAvatar(int id): Entity(id){}
+        void update() override {cout << "Female avatar updated";}
+};
+
+//a family is a set of related products that must be created together (a Male always comes with a MaleAvatar) -> one factory per family, one factory method per product
+///runtime flavor: the family is chosen at runtime through the vtable
+class AbstractFactory{
+    public:
+        virtual Human* createHuman(string name) = 0;
+        virtual Entity* createEntity(int id) = 0;
+        virtual ~AbstractFactory() = default;
+};
+
+class MaleFactory: public AbstractFactory{
+    public:
+        Human* createHuman(string name) override{
+            return new Male(name);
+        }
+        Entity* createEntity(int id) override{
+            return new MaleAvatar(id);
+        }
+};
+
+class FemaleFactory: public AbstractFactory{
+    public:
+        Human* createHuman(string name) override{
+            return new Female(name);
+        }
+        Entity* createEntity(int id) override{
+            return new FemaleAvatar(id);
+        }
+};
+
+///compile-time flavor: the family is a policy type, products are built by value with their concrete type known -> inlined construction, no dispatch, no heap
+template<typename HumanT, typename EntityT>
+struct FamilyPolicy{
+    static_assert(is_base_of<Human, HumanT>::value && is_base_of<Entity, EntityT>::value, "a family pairs a Human with an Entity");
+    using HumanType = HumanT;
+    using EntityType = EntityT;
+};
+
+using MaleFamily = FamilyPolicy<Male, MaleAvatar>;
+using FemaleFamily = FamilyPolicy<Female, FemaleAvatar>;
+
+template<typename Family>
+class StaticFactory{
+    public:
+        using HumanType = typename Family::HumanType;
+        using EntityType = typename Family::EntityType;
+
+        static HumanType createHuman(string name){
+            return HumanType(std::move(name));
+        }
+        static EntityType createEntity(int id){
+            return EntityType(id);
+        }
+        static pair<HumanType, EntityType> createFamily(string name, int id){
+            return {createHuman(std::move(name)), createEntity(id)};
+        }
+};
+
+//benchmark: n families created through AbstractFactory* vs StaticFactory<Family>
+void benchFamilyCreation(long n){
+    MaleFactory male;
+    FemaleFactory female;
+    AbstractFactory* factories[2] = {&male, &female};
+    long sink = 0;
+
+    auto start = chrono::steady_clock::now();
+    for (long i = 0; i < n; i++){
+        AbstractFactory* f = factories[i & 1];
+        Human* h = f->createHuman("Ayoub");
+        Entity* e = f->createEntity(static_cast<int>(i));
+        sink += e->getId();
+        delete h;
+        delete e;
+    }
+    auto middle = chrono::steady_clock::now();
+    for (long i = 0; i < n; i += 2){
+        auto m = StaticFactory<MaleFamily>::createFamily("Ayoub", static_cast<int>(i));
+        auto fe = StaticFactory<FemaleFamily>::createFamily("Ayoub", static_cast<int>(i + 1));
+        sink += m.second.getId() + fe.second.getId();
+    }
+    auto end = chrono::steady_clock::now();
+
+    cout << n << " families: runtime " << chrono::duration<double, milli>(middle - start).count() << " ms, template " << chrono::duration<double, milli>(end - middle).count() << " ms (" << sink << ")\n";
+}
+
+int main(){
+    AbstractFactory* af = new FemaleFactory; //family selected at runtime
+    Human* h = af->createHuman("Ayoub");
+    Entity* e = af->createEntity(1);
+    h->reproduce();
+    e->update();
+    delete h;
+    delete e;
+    delete af;
+
+    auto family = StaticFactory<MaleFamily>::createFamily("Ayoub", 2); //family selected at compile time
+    family.first.reproduce();
+    family.second.update();
+
+    benchFamilyCreation(10000000);
+    return 0;
+}
+
+
+//Data-oriented Entity storage: millions of Entity objects means one virtual update() call and one scattered heap object per entity per frame -> keep the components in structure-of-arrays form (one contiguous array per field) and run each system as a tight loop over those arrays (auto-vectorized, split across cores)
+///entity ids are dense (small integers) so a sparse set maps id -> slot in O(1) and removal swaps the last slot into the hole to keep the arrays packed
+class EntityWorld{
+    static constexpr uint32_t npos = UINT32_MAX;
+    vector<uint32_t> slotOf; //sparse: id -> dense slot
+    vector<int> ids; //dense: slot -> id
+    vector<float> x, y, vx, vy; //components (SoA)
+
+    static void integrateRange(float* __restrict px, float* __restrict py, const float* __restrict pvx, const float* __restrict pvy, size_t n, float dt){
+        for (size_t k = 0; k < n; k++){ //no aliasing, no branches -> vectorized by the compiler
+            px[k] += pvx[k] * dt;
+            py[k] += pvy[k] * dt;
+        }
+    }
+
+    uint32_t slot(int id) const { //every accessor goes through here: unknown and destroyed ids are both rejected
+        if (!contains(id)) throw out_of_range("No entity with id " + to_string(id));
+        return slotOf[id];
+    }
+    public:
+        void create(int id, float px, float py, float pvx, float pvy){
+            if (id < 0) throw invalid_argument("Entity ids must be non-negative");
+            if (static_cast<size_t>(id) >= slotOf.size()) slotOf.resize(id + 1, npos);
+            if (slotOf[id] != npos) throw invalid_argument("Entity id already in use");
+            slotOf[id] = static_cast<uint32_t>(ids.size());
+            ids.push_back(id);
+            x.push_back(px);
+            y.push_back(py);
+            vx.push_back(pvx);
+            vy.push_back(pvy);
+        }
+
+        void destroy(int id){ //swap-remove: O(1), arrays stay dense; destroying an id that is not alive does nothing, like contains()
+            if (!contains(id)) return;
+            uint32_t s = slotOf[id];
+            uint32_t last = static_cast<uint32_t>(ids.size() - 1);
+            ids[s] = ids[last];
+            x[s] = x[last];
+            y[s] = y[last];
+            vx[s] = vx[last];
+            vy[s] = vy[last];
+            slotOf[ids[s]] = s;
+            slotOf[id] = npos;
+            ids.pop_back(); x.pop_back(); y.pop_back(); vx.pop_back(); vy.pop_back();
+        }
+
+        bool contains(int id) const {
+            return id >= 0 && static_cast<size_t>(id) < slotOf.size() && slotOf[id] != npos;
+        }
+
+        size_t size() const {
+            return ids.size();
+        }
+
+        float getX(int id) const { return x[slot(id)]; } //throws out_of_range if the id is not alive
+        float getY(int id) const { return y[slot(id)]; }
+
+        //movement system over the whole world
+        void integrate(float dt){
+            integrateRange(x.data(), y.data(), vx.data(), vy.data(), ids.size(), dt);
+        }
+
+        //same system split into contiguous chunks, one per thread (chunks never overlap so no synchronization is needed)
+        void integrateParallel(float dt, unsigned nThreads){
+            size_t n = ids.size();
+            nThreads = max(1u, min<unsigned>(nThreads, static_cast<unsigned>(n / 4096 + 1)));
+            size_t chunk = (n + nThreads - 1) / nThreads;
+            vector<thread> workers;
+            for (unsigned t = 1; t < nThreads; t++){
+                size_t begin = t * chunk;
+                if (begin >= n) break;
+                size_t count = min(chunk, n - begin);
+                workers.emplace_back(integrateRange, x.data() + begin, y.data() + begin, vx.data() + begin, vy.data() + begin, count, dt);
+            }
+            integrateRange(x.data(), y.data(), vx.data(), vy.data(), min(chunk, n), dt); //the calling thread takes the first chunk
+            for (thread& w: workers) w.join();
+        }
+
+        //per-entity update, used by the compatibility adapter
+        void integrateOne(int id, float dt){
+            uint32_t s = slot(id);
+            x[s] += vx[s] * dt;
+            y[s] += vy[s] * dt;
+        }
+};
+
+//compatibility adapter: code written against the virtual Entity::update keeps working, the state lives in the world
+class WorldEntity: public Entity{
+    EntityWorld* world;
+    float dt;
+    public:
+        WorldEntity(int id, EntityWorld* w, float d): Entity(id), world(w), dt(d){}
+
+        void update() override{
+            world->integrateOne(getId(), dt);
+        }
 };
 
+int main(){
+    EntityWorld world;
+    for (int id = 0; id < 1000000; id++){
+        world.create(id, 0.0f, 0.0f, 1.0f, 2.0f);
+    }
+    world.integrate(0.016f); //one contiguous pass
+    world.integrateParallel(0.016f, thread::hardware_concurrency());
+    world.destroy(42); //the last entity moves into slot 42
+
+    WorldEntity legacy(7, &world, 0.016f);
+    Entity* e = &legacy;
+    e->update(); //virtual call still supported
+    cout << world.getX(7) << " " << world.getY(7) << " (" << world.size() << " entities)";
+    return 0;
+}
+
 
 //Builder: Object has many optional parts constructed step-by-step (constructor overloading) -> separating construction of a complex object from its representation (one construction can work with different representations)
 
 class Builder{
-    int x,y,z;
+    int x = 0, y = 0, z = 0; //fields that no overload sets are zero instead of uninitialized
     public: 
         Builder(){
             this->x = 2; 
@@ -306,8 +992,71 @@ class Builder{
 };
 
 
+//Step builder: each step returns the builder with the fields set so far encoded in its type (typestate) -> forgetting the mandatory x is a compile error instead of a silently picked overload like Builder(2,0,0)
+///the product is held by value inside the builder and returned with guaranteed copy elision: no temporaries, no heap, and everything is constexpr
+struct Coordinates{
+    int x;
+    int y;
+    int z;
+};
+
+template<bool HasX>
+class StepBuilder{
+    Coordinates c;
+
+    template<bool> friend class StepBuilder;
+    constexpr explicit StepBuilder(Coordinates cc): c(cc){}
+    public:
+        constexpr StepBuilder(): c{0, 0, 0}{}
+
+        constexpr StepBuilder<true> withX(int v) const {
+            return StepBuilder<true>(Coordinates{v, c.y, c.z});
+        }
+        constexpr StepBuilder withY(int v) const {
+            return StepBuilder(Coordinates{c.x, v, c.z});
+        }
+        constexpr StepBuilder withZ(int v) const {
+            return StepBuilder(Coordinates{c.x, c.y, v});
+        }
+
+        constexpr Coordinates build() const {
+            static_assert(HasX, "x is mandatory: call withX() before build()");
+            return c;
+        }
+};
+
+using CoordinatesBuilder = StepBuilder<false>;
+
+//bulk builder: fills a contiguous array of products from columnar inputs (x is mandatory, an empty y or z column means default 0)
+class BulkBuilder{
+    public:
+        static void build(const vector<int>& xs, const vector<int>& ys, const vector<int>& zs, vector<Coordinates>& out){
+            size_t n = xs.size();
+            if ((!ys.empty() && ys.size() != n) || (!zs.empty() && zs.size() != n)){
+                throw invalid_argument("BulkBuilder: columns must have the same length");
+            }
+            out.resize(n);
+            Coordinates* dst = out.data();
+            for (size_t k = 0; k < n; k++){
+                dst[k].x = xs[k];
+                dst[k].y = ys.empty() ? 0 : ys[k];
+                dst[k].z = zs.empty() ? 0 : zs[k];
+            }
+        }
+};
+
+
 int main(){
-    Builder b(2,0,0);
+    Builder b(2,0,0); //picks Builder(int xx, int yy, int zz), not the (int, bool, bool) overload
+
+    Coordinates c = CoordinatesBuilder().withX(2).withZ(5).build(); //y defaults to 0
+    constexpr Coordinates origin = CoordinatesBuilder().withX(0).build(); //built at compile time
+    static_assert(origin.y == 0, "defaults are applied at compile time");
+    // CoordinatesBuilder().withY(1).build(); //does not compile: x is missing
+
+    vector<Coordinates> batch;
+    BulkBuilder::build({1, 2, 3}, {}, {7, 8, 9}, batch);
+    cout << c.x << "," << c.y << "," << c.z << " and " << batch.size() << " built in bulk\n"; //2,0,5 and 3 built in bulk
 };
 
 
@@ -335,10 +1084,106 @@ class Book{
             this->title = b.title;
         }
 
+        friend class BookPrototypeRegistry;
 };
 
 Book* Book::b = nullptr;
 
+//Copy-on-write prototypes: most clones are only read, so a clone shares the prototype's title string and only gets its own on a title change; the code is a plain int copied with the clone
+///not thread-safe: a clone and its registry belong to one thread, and clones must not outlive their registry (they report to its counters)
+struct BookPayload{ //what a prototype holds
+    int code;
+    shared_ptr<const string> title;
+
+    size_t deepCopyBytes() const { //inline + heap footprint of one deep-copied Book
+        return sizeof(int) + sizeof(string) + heapBytes(*title);
+    }
+};
+
+class BookPrototypeRegistry;
+
+class BookClone{
+    int code; //by value: a code change copies nothing
+    shared_ptr<const string> title; //shared with the prototype until setTitle
+    bool detached = false; //already counted in the registry's stats
+    BookPrototypeRegistry* registry;
+    public:
+        BookClone(const BookPayload& p, BookPrototypeRegistry* r): code(p.code), title(p.title), registry(r){}
+
+        int getCode() const { return code; }
+        const string& getTitle() const { return *title; }
+
+        void setCode(int c){
+            code = c;
+        }
+        void setTitle(string t); //the new title replaces the shared one, the old one is never copied
+
+        bool isShared() const { return title.use_count() > 1; }
+};
+class BookPrototypeRegistry{
+    public:
+        struct Stats{
+            size_t clones = 0; //clones handed out
+            size_t detaches = 0; //clones that got their own title
+            size_t copiedBytes = 0; //bytes of the first own title of each detached clone (what copy-on-write did pay)
+            size_t sharedBytes = 0; //bytes a deep copy per clone would have cost
+        };
+
+        void registerPrototype(int id, const Book& origin){
+            prototypes[id] = BookPayload{origin.code, make_shared<const string>(origin.title)};
+        }
+
+        BookClone clone(int id){ //O(1): a reference count increment, no string copy
+            const BookPayload& proto = prototypes.at(id);
+            stats.clones++;
+            stats.sharedBytes += proto.deepCopyBytes();
+            return BookClone(proto, this);
+        }
+
+        const Stats& getStats() const { return stats; }
+
+        size_t savedBytes() const { return stats.sharedBytes > stats.copiedBytes ? stats.sharedBytes - stats.copiedBytes : 0; } //clamped: never wraps around
+    private:
+        unordered_map<int, BookPayload> prototypes; //keyed by prototype ID
+        Stats stats;
+        friend class BookClone;
+};
+
+void BookClone::setTitle(string t){
+    title = make_shared<const string>(std::move(t));
+    if (!detached){ //a clone is counted once, later title changes replace its own copy
+        detached = true;
+        registry->stats.detaches++;
+        registry->stats.copiedBytes += sizeof(string) + heapBytes(*title);
+    }
+}
+
+//throughput: n deep copies of the origin vs n copy-on-write clones (10% of which are modified)
+///copy-on-write wins on memory, and on time once titles are long enough to live on the heap; the origin's short title fits in the string object, so a deep copy is about as cheap as a reference count
+void benchBookCloning(long n){
+    BookPrototypeRegistry registry;
+    registry.registerPrototype(1, Book::getOrigin());
+    long sink = 0;
+
+    auto start = chrono::steady_clock::now();
+    for (long i = 0; i < n; i++){
+        Book copy(Book::getOrigin());
+        sink += sizeof(copy);
+    }
+    auto middle = chrono::steady_clock::now();
+    for (long i = 0; i < n; i++){
+        BookClone c = registry.clone(1);
+        if (i % 10 == 0) c.setCode(static_cast<int>(i)); //no copy at all
+        if (i % 100 == 0) c.setTitle("Reprint"); //only the new title is allocated
+        sink += c.getCode();
+    }
+    auto end = chrono::steady_clock::now();
+
+    const BookPrototypeRegistry::Stats& st = registry.getStats();
+    cout << n << " clones: deep copy " << chrono::duration<double, milli>(middle - start).count() << " ms, copy-on-write " << chrono::duration<double, milli>(end - middle).count() << " ms, "
+         << st.detaches << "/" << st.clones << " detached, " << registry.savedBytes() << " bytes saved (" << sink << ")\n";
+}
+
 int main(){
     //expensive object created once
 
@@ -346,6 +1191,15 @@ int main(){
 
     Book xx(Book::getOrigin()); //explicit copy (no shallow-deep distinction)
 
+    BookPrototypeRegistry registry;
+    registry.registerPrototype(1, Book::getOrigin());
+    BookClone c1 = registry.clone(1); //shares the origin's title
+    BookClone c2 = registry.clone(1);
+    c2.setCode(2); //nothing copied, the title is still shared
+    c2.setTitle("Second edition"); //c2 gets its own title, c1 still shares the origin's
+
+    benchBookCloning(1000000);
+
     return 0; 
 }
 
@@ -379,28 +1233,91 @@ class Human: public Think, public Philosophize{
         }
 };
 
+//the operation is resolved once (string -> HumanAction) and then dispatched through a jump table or a compile-time tag, instead of comparing strings on every call
+enum class HumanAction : uint8_t { Think, Philosophize, Count };
+
 class Adapter{
     Human h; //using object composition (value attribute)
+
+    using Action = void (*)(Human&);
+    static constexpr Action jumpTable[] = { //indexed by HumanAction, qualified calls are not virtual
+        [](Human& hu){ hu.Human::think(); },
+        [](Human& hu){ hu.Human::philosophize(); },
+    };
+
+    //perfect hash front end for runtime strings: the name length mod 4 is collision-free over the known names (checked after the class), one final compare rejects unknown input
+    static constexpr string_view slotNames[4] = {"philosophize", "think", "", ""};
+    static constexpr HumanAction slotActions[4] = {HumanAction::Philosophize, HumanAction::Think, HumanAction::Count, HumanAction::Count};
+    static constexpr size_t slotOf(string_view type){ return type.size() & 3; }
     public:
-        void actHuman(string type){
-            if (type == "think"){
-                h.think(); 
-            }
-            if (type == "philosophize"){
-                h.philosophize(); 
-            }
+        static constexpr HumanAction resolve(string_view type){ //HumanAction::Count for unknown input
+            size_t slot = slotOf(type);
+            return slotNames[slot] == type ? slotActions[slot] : HumanAction::Count;
         }
-};
 
+        void actHuman(HumanAction a){ //resolved once, dispatched in O(1)
+            if (a < HumanAction::Count) jumpTable[static_cast<size_t>(a)](h);
+        }
 
-int main(){
-    string t;
-    cin >> "give a capability" >> t; 
-    
-    Adapter ap;
+        void actHuman(string_view type){ //runtime string input still accepted
+            actHuman(resolve(type));
+        }
 
-    ap.actHuman(t); 
-    
+        template<HumanAction A>
+        void act(){ //compile-time tag: the call is inlined
+            static_assert(A < HumanAction::Count, "unknown action");
+            if constexpr (A == HumanAction::Think) h.Human::think();
+            else h.Human::philosophize();
+        }
+};
+
+static_assert(Adapter::resolve("think") == HumanAction::Think && Adapter::resolve("philosophize") == HumanAction::Philosophize, "the perfect hash must map every action name to its own slot");
+
+//benchmark: cost per call of the former string matching (string by value + compares) vs the perfect hash, the pre-resolved enum and the compile-time tag
+void benchAdapter(long n){
+    Adapter ap;
+    Human h;
+    auto legacy = [&h](string type){
+        if (type == "think"){
+            h.think(); 
+        }
+        if (type == "philosophize"){
+            h.philosophize(); 
+        }
+    };
+    const char* inputs[2] = {"think", "philosophize"};
+    HumanAction resolved[2] = {Adapter::resolve(inputs[0]), Adapter::resolve(inputs[1])};
+    streambuf* out = cout.rdbuf(nullptr); //silence the output so only dispatch is measured
+    auto time = [n](auto&& f){
+        auto start = chrono::steady_clock::now();
+        for (long i = 0; i < n; i++) f(i & 1);
+        return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+    };
+    double legacyNs = time([&](long k){ legacy(inputs[k]); });
+    double hashNs = time([&](long k){ ap.actHuman(string_view(inputs[k])); });
+    double enumNs = time([&](long k){ ap.actHuman(resolved[k]); });
+    double tagNs = time([&](long k){ if (k) ap.act<HumanAction::Philosophize>(); else ap.act<HumanAction::Think>(); });
+    cout.rdbuf(out);
+    cout.clear();
+    cout << "ns/call: string matching " << legacyNs << ", perfect hash " << hashNs << ", enum " << enumNs << ", tag " << tagNs << "\n";
+}
+
+
+int main(){
+    string t;
+    cout << "give a capability"; 
+    cin >> t; 
+    
+    Adapter ap;
+
+    ap.actHuman(t); //one hash + one compare
+
+    HumanAction a = Adapter::resolve(t); //resolve once, reuse on the hot path
+    ap.actHuman(a);
+    ap.act<HumanAction::Think>();
+
+    benchAdapter(10000000);
+    
 }; 
 
 
@@ -413,19 +1330,208 @@ int main(){
 /// What-How Orthogonality: all combinations between what the user interacts with and how it works underneath are possible by design -> no need to add as many subclasses of a given refinement/extension as exisitng implememtations (because implementatons are universal and independent of what the user interacts with, ie, interface)
 //// Single Responsibility Principle: focus on high-level logic in the abstraction and platform details in implementation one at a time.
 
+//Submission/completion queues (io_uring style): the user interface enqueues many requests, a worker thread drains them in batches through Kernel::sendRequests and posts one completion per request
+struct KernelRequest{
+    uint64_t userData; //echoed back in the completion so the submitter can match them
+    string hardware;
+};
+
+struct KernelCompletion{
+    uint64_t userData;
+    int result; //0 on success
+};
+
+
+class Kernel{ //Implementation/Platform: how a user interface work 
+    public:
+        virtual ~Kernel() = default;
+        virtual void sendRequest(string hardware) = 0; 
+
+        //batched version: one call handles a whole batch (default: one sendRequest per request)
+        virtual void sendRequests(const KernelRequest* requests, size_t n, KernelCompletion* completions){
+            for (size_t k = 0; k < n; k++){
+                sendRequest(requests[k].hardware);
+                completions[k] = KernelCompletion{requests[k].userData, 0};
+            }
+        }
+}; 
+
+
+class MicroKernel: public Kernel{
+    int memory;
+    public:
+        static constexpr const char* design = "Micro"; //design string understood by UserInterface
+        MicroKernel(int m): memory(m){}
+
+        void sendRequest(string hardware) override{
+            cout << "Multiple requests sent to" << hardware; 
+        }
+
+        void sendRequests(const KernelRequest* requests, size_t n, KernelCompletion* completions) override{ //one message for the whole batch
+            string message = "Multiple requests sent to";
+            for (size_t k = 0; k < n; k++){
+                message += ' ';
+                message += requests[k].hardware;
+                completions[k] = KernelCompletion{requests[k].userData, 0};
+            }
+            cout << message;
+        }
+}; 
+
+
+class MonoKernel: public Kernel{
+    int memory;
+    public:
+        static constexpr const char* design = "Mono";
+        MonoKernel(int m): memory(m){}
+
+        void sendRequest(string hardware) override{
+            cout << "One request sent to" << hardware; 
+        }
+
+        void sendRequests(const KernelRequest* requests, size_t n, KernelCompletion* completions) override{ //the monolithic kernel still serves requests one by one, but with a single write
+            string message;
+            for (size_t k = 0; k < n; k++){
+                message += "One request sent to";
+                message += requests[k].hardware;
+                completions[k] = KernelCompletion{requests[k].userData, 0};
+            }
+            cout << message;
+        }
+
+};
+
+class KernelRing{
+    Kernel* ker; //not owned
+    vector<KernelRequest> submissions; //fixed-size submission ring
+    size_t head = 0, count = 0;
+    vector<KernelCompletion> completions; //completion queue, emptied by reap()
+    size_t completionEntries; //bound on completions: a submission is refused while inFlight + unreaped would exceed it
+    size_t inFlight = 0; //submitted but not yet completed
+    size_t completionWaiters = 0; //threads blocked in reap(wait) or waitAll(): the worker only notifies when there is one
+    size_t maxBatch;
+    bool stopping = false;
+    mutex m;
+    condition_variable notEmpty, notFull, completed;
+    thread worker;
+
+    void drain(){
+        vector<KernelRequest> batch;
+        vector<KernelCompletion> done;
+        unique_lock<mutex> lock(m);
+        while (true){
+            notEmpty.wait(lock, [this](){ return count > 0 || stopping; });
+            if (count == 0) return; //stopping and nothing left
+            size_t n = min(count, maxBatch);
+            batch.clear();
+            for (size_t k = 0; k < n; k++){
+                batch.push_back(std::move(submissions[(head + k) % submissions.size()]));
+            }
+            bool wasFull = count == submissions.size();
+            head = (head + n) % submissions.size();
+            count -= n;
+            if (wasFull) notFull.notify_all();
+
+            lock.unlock(); //the kernel works without holding the queue lock
+            done.resize(n);
+            ker->sendRequests(batch.data(), n, done.data());
+            lock.lock();
+
+            completions.insert(completions.end(), done.begin(), done.end()); //never grows past completionEntries: submissions reserve their slot
+            inFlight -= n;
+            if (completionWaiters > 0) completed.notify_all(); //one lock and at most one notify per batch
+        }
+    }
+    public:
+        KernelRing(Kernel* k, size_t entries = 1024, size_t batch = 64): ker(k), submissions(entries), completionEntries(2 * entries), maxBatch(batch){
+            completions.reserve(completionEntries);
+            worker = thread(&KernelRing::drain, this);
+        }
+        KernelRing(const KernelRing&) = delete;
+        KernelRing& operator=(const KernelRing&) = delete;
+
+        ~KernelRing(){ //pending requests are still served before the worker exits
+            {
+                lock_guard<mutex> lock(m);
+                stopping = true;
+            }
+            notEmpty.notify_all();
+            worker.join();
+        }
+
+        //blocks while the submission ring is full (the worker always drains it); refused (false) while the completion ring has no room left: reap first (like io_uring's -EBUSY)
+        bool submit(string hardware, uint64_t userData){
+            unique_lock<mutex> lock(m);
+            notFull.wait(lock, [this](){ return count < submissions.size(); });
+            if (inFlight + completions.size() >= completionEntries) return false; //checked after the wait: other submitters may have taken the last slots meanwhile
+            submissions[(head + count) % submissions.size()] = KernelRequest{userData, std::move(hardware)};
+            count++;
+            inFlight++;
+            if (count == 1) notEmpty.notify_one(); //the worker only sleeps on an empty ring
+            return true;
+        }
+
+        size_t submitBatch(const vector<string>& hardware, uint64_t firstUserData){ //one lock per ring-full instead of one per request, userData = firstUserData + index; returns how many were accepted (stops when the completion ring is full)
+            size_t k = 0;
+            while (k < hardware.size()){
+                unique_lock<mutex> lock(m);
+                notFull.wait(lock, [this](){ return count < submissions.size(); });
+                if (inFlight + completions.size() >= completionEntries) break;
+                bool wasEmpty = count == 0;
+                for (; k < hardware.size() && count < submissions.size() && inFlight + completions.size() < completionEntries; k++){
+                    submissions[(head + count) % submissions.size()] = KernelRequest{firstUserData + k, hardware[k]};
+                    count++;
+                    inFlight++;
+                }
+                if (wasEmpty) notEmpty.notify_one();
+            }
+            return k;
+        }
+
+        size_t reap(vector<KernelCompletion>& out, bool wait = false){ //moves every available completion to out; wait: block until there is at least one (if anything is in flight)
+            unique_lock<mutex> lock(m);
+            if (wait){
+                completionWaiters++;
+                completed.wait(lock, [this](){ return !completions.empty() || inFlight == 0; });
+                completionWaiters--;
+            }
+            size_t n = completions.size();
+            out.insert(out.end(), completions.begin(), completions.end());
+            completions.clear();
+            return n;
+        }
+
+        void waitAll(){ //blocks until every submitted request has completed
+            unique_lock<mutex> lock(m);
+            completionWaiters++;
+            completed.wait(lock, [this](){ return inFlight == 0; });
+            completionWaiters--;
+        }
+};
+
+
 class UserInterface{ //Abstraction/Interface: what the user sees or interacts with
     protected:
         int quality; 
         string version;
         int date;
         string design;
-        Kernel* ker;
+        Kernel* ker = nullptr;
+        unique_ptr<KernelRing> ring; //created on the first asynchronous request
     public:
         UserInterface(int q, string v, int d, string des): quality(q), version(v), date(d), design(des){
             if (this->design == "Mono") ker = new MonoKernel(20); 
             if (design == "Micro") ker = new MicroKernel(20); 
         }
 
+        UserInterface(const UserInterface&) = delete; //owns ker
+        UserInterface& operator=(const UserInterface&) = delete;
+
+        virtual ~UserInterface(){
+            ring.reset(); //drain before the kernel goes away
+            delete ker;
+        }
+
         UserInterface& showInterface(){
             return *this;
         }
@@ -433,6 +1539,20 @@ class UserInterface{ //Abstraction/Interface: what the user sees or interacts wi
         void displayResult(){
             cout << "Result!"; 
         }
+
+        //asynchronous path: enqueue now, the kernel serves the requests in batches
+        bool submitRequest(string hardware, uint64_t userData = 0){ //false: too many unreaped results, call reapResults first
+            if (!ring) ring = make_unique<KernelRing>(ker);
+            return ring->submit(std::move(hardware), userData);
+        }
+
+        size_t reapResults(vector<KernelCompletion>& out){
+            return ring ? ring->reap(out) : 0;
+        }
+
+        void waitResults(){
+            if (ring) ring->waitAll();
+        }
 }; 
 
 
@@ -441,7 +1561,7 @@ class UserInterface{ //Abstraction/Interface: what the user sees or interacts wi
 class GraphicalUserInterface: public UserInterface{
     string cursor;
     public:
-        GraphicalUserInterface(int q, string v, int d, string des, string c): UserInterface::UserInterface(q,v,d,des), cursor(c){}
+        GraphicalUserInterface(int q, string v, int d, string des, string c): UserInterface(q,v,d,des), cursor(c){}
 
         string showCursor(){
             ker->sendRequest("show Cursor!"); 
@@ -452,6 +1572,10 @@ class GraphicalUserInterface: public UserInterface{
             ker->sendRequest("click Cursor!"); 
             cout << "Cursor clicked!";
         }
+
+        void clickCursorAsync(){
+            submitRequest("click Cursor!"); 
+        }
 };
 
 
@@ -474,37 +1598,178 @@ class Terminal: public UserInterface{
             ker->sendRequest("execute command!"); 
             cout << "Command" << commands[k] << "executed!"; 
         }
+
+        size_t executeAllCommandsAsync(){ //one submission per command, completed in batches; returns how many were accepted
+            size_t k = 0;
+            while (k < commands.size() && submitRequest("execute command!", k)) k++;
+            return k;
+        }
 };
 
+//Compile-time Bridge: when a deployment fixes the combination (e.g. Terminal on MonoKernel) the implementation becomes a template parameter held by value -> no Kernel* indirection and the kernel call is inlined
+///toRuntime() gives back the runtime-polymorphic form above for plugin code that needs a Kernel* behind the interface
+template<typename KernelPolicy>
+class UserInterfaceT{
+    static_assert(is_base_of<Kernel, KernelPolicy>::value, "KernelPolicy must implement Kernel");
+    protected:
+        int quality; 
+        string version;
+        int date;
+        KernelPolicy ker; //by value
 
-class Kernel{ //Implementation/Platform: how a user interface work 
+        void request(string hardware){
+            ker.KernelPolicy::sendRequest(std::move(hardware)); //qualified call: resolved at compile time
+        }
     public:
-        virtual ~Kernel() = default;
-        virtual void sendRequest(string hardware) = 0; 
-}; 
+        UserInterfaceT(int q, string v, int d, int memory = 20): quality(q), version(v), date(d), ker(memory){}
 
+        void displayResult(){
+            cout << "Result!"; 
+        }
+};
 
-class MicroKernel: public Kernel{
-    int memory;
+template<typename KernelPolicy>
+class GraphicalUserInterfaceT: public UserInterfaceT<KernelPolicy>{
+    string cursor;
     public:
-        MicroKernel(int m): memory(m){}
+        GraphicalUserInterfaceT(int q, string v, int d, string c): UserInterfaceT<KernelPolicy>(q,v,d), cursor(c){}
 
-        void sendRequest(string hardware) override{
-            cout << "Multiple requests sent to" << hardware; 
+        string showCursor(){
+            this->request("show Cursor!"); 
+            return this->cursor;
+        }
+
+        void clickCursor(){
+            this->request("click Cursor!"); 
+            cout << "Cursor clicked!";
         }
-}; 
 
+        GraphicalUserInterface toRuntime() const {
+            return GraphicalUserInterface(this->quality, this->version, this->date, KernelPolicy::design, cursor);
+        }
+};
 
-class MonoKernel: public Kernel{
-    int memory;
+template<typename KernelPolicy>
+class TerminalT: public UserInterfaceT<KernelPolicy>{
+    vector<string> commands; 
     public:
-        MonoKernel(int m): memory(m){}
+        TerminalT(int q, string v, int d, vector<string> c): UserInterfaceT<KernelPolicy>(q,v,d), commands(c){}
 
-        void sendRequest(string hardware) override{
-            cout << "One request sent to" << hardware; 
+        string showCommand(int k){
+            this->request("show command!"); 
+            return commands[k]; 
+        }
+
+        void executeCommands(int k){
+            this->request("execute command!"); 
+            cout << "Command" << commands[k] << "executed!"; 
         }
 
+        Terminal toRuntime() const {
+            return Terminal(this->quality, this->version, this->date, KernelPolicy::design, commands);
+        }
+};
+
+//benchmark: runtime bridge (Kernel* + virtual call) vs template bridge, for the four GUI/Terminal x Micro/Mono combinations
+template<typename KernelPolicy>
+void benchBridgeCombination(const char* name, long n){
+    GraphicalUserInterface gui(1, "1.0", 2024, KernelPolicy::design, "arrow");
+    GraphicalUserInterfaceT<KernelPolicy> guiT(1, "1.0", 2024, "arrow");
+    Terminal term(1, "1.0", 2024, KernelPolicy::design, {"ls"});
+    TerminalT<KernelPolicy> termT(1, "1.0", 2024, {"ls"});
+    auto time = [n](auto&& f){
+        auto start = chrono::steady_clock::now();
+        for (long i = 0; i < n; i++) f();
+        return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+    };
+    streambuf* out = cout.rdbuf(nullptr); //silence the output so only the bridge is measured
+    double guiNs = time([&](){ gui.clickCursor(); });
+    double guiTNs = time([&](){ guiT.clickCursor(); });
+    double termNs = time([&](){ term.executeCommands(0); });
+    double termTNs = time([&](){ termT.executeCommands(0); });
+    cout.rdbuf(out);
+    cout.clear();
+    cout << "GUI/" << name << ": runtime " << guiNs << " ns, template " << guiTNs << " ns; Terminal/" << name << ": runtime " << termNs << " ns, template " << termTNs << " ns\n";
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+class SyscallSink: public streambuf{ //unbuffered: every write reaches the OS (/dev/null), like a kernel message -> this is the per-message cost batching amortizes
+    int fd;
+    protected:
+        int_type overflow(int_type c) override{
+            char ch = static_cast<char>(c);
+            return ::write(fd, &ch, 1) == 1 ? c : traits_type::eof();
+        }
+        streamsize xsputn(const char* data, streamsize n) override{
+            return ::write(fd, data, static_cast<size_t>(n));
+        }
+    public:
+        SyscallSink(): fd(::open("/dev/null", O_WRONLY)){}
+        ~SyscallSink(){ if (fd >= 0) ::close(fd); }
 };
+#endif
+
+//benchmark: n requests through one virtual sendRequest call each vs the submission ring (batched worker)
+///the kernels' output goes to an unbuffered sink: silencing it (rdbuf(nullptr)) would make every message free and leave batching nothing to amortize
+void benchKernelBatching(long n){
+#if defined(__unix__) || defined(__APPLE__)
+    SyscallSink sink;
+    streambuf* out = cout.rdbuf(&sink);
+#else
+    streambuf* out = cout.rdbuf(nullptr);
+#endif
+    MicroKernel micro(20);
+    MonoKernel mono(20);
+    Kernel* kernels[2] = {&micro, &mono};
+    double perCallMs[2], batchedMs[2];
+    for (int k = 0; k < 2; k++){
+        auto start = chrono::steady_clock::now();
+        for (long i = 0; i < n; i++){
+            kernels[k]->sendRequest("execute command!");
+        }
+        auto middle = chrono::steady_clock::now();
+        {
+            KernelRing ring(kernels[k]);
+            vector<string> chunk(256, "execute command!");
+            vector<KernelCompletion> done;
+            long i = 0;
+            while (i < n){
+                if (static_cast<size_t>(n - i) < chunk.size()) chunk.resize(n - i); //last chunk: only the remainder
+                size_t accepted = ring.submitBatch(chunk, i);
+                i += accepted;
+                done.clear();
+                ring.reap(done, accepted < chunk.size()); //completion ring full: wait for room
+            }
+            ring.waitAll();
+        }
+        auto end = chrono::steady_clock::now();
+        perCallMs[k] = chrono::duration<double, milli>(middle - start).count();
+        batchedMs[k] = chrono::duration<double, milli>(end - middle).count();
+    }
+    cout.rdbuf(out);
+    cout.clear();
+    cout << n << " requests: MicroKernel per-call " << perCallMs[0] << " ms, batched " << batchedMs[0] << " ms; MonoKernel per-call " << perCallMs[1] << " ms, batched " << batchedMs[1] << " ms\n";
+}
+
+int main(){
+    Terminal term(1, "1.0", 2024, "Micro", {"ls", "pwd", "whoami"});
+    term.executeCommands(0); //synchronous: one virtual call per request
+    term.executeAllCommandsAsync(); //asynchronous: enqueued, served in batches
+    term.waitResults();
+    vector<KernelCompletion> done;
+    term.reapResults(done);
+    cout << done.size() << " requests completed";
+
+    benchKernelBatching(1000000);
+
+    TerminalT<MonoKernel> fixedTerm(1, "1.0", 2024, {"ls", "pwd"}); //combination fixed at build time
+    fixedTerm.executeCommands(1);
+    Terminal pluginTerm = fixedTerm.toRuntime(); //back to the runtime-polymorphic form
+
+    benchBridgeCombination<MicroKernel>("Micro", 10000000);
+    benchBridgeCombination<MonoKernel>("Mono", 10000000);
+    return 0;
+}
 
 
 //Decorator: add behavior to an object dynamically without modifying the class (dependency)
@@ -521,6 +1786,10 @@ class Student {
             cout << "passed exam!"; 
         }
 
+        string getName() const {
+            return name;
+        }
+
         friend class Decorator; 
 };  
 
@@ -540,6 +1809,130 @@ class Decorator{
         }
 };  
 
+//Decorator chain: each layer wraps the next one and adds behavior before/after forwarding (validation -> audit -> persistence -> store)
+///grades are set in batches (pointer + count over contiguous students): each layer sees the whole batch once instead of once per student
+class GradeStore{ //innermost component: writes the grades into the students
+    Decorator dec;
+    public:
+        void setGrades(Student* students, const double* grades, size_t n){
+            for (size_t k = 0; k < n; k++){
+                dec.setGrade(students[k], grades[k]);
+            }
+        }
+
+        double getGrade(Student& s){
+            return dec.getGrade(s);
+        }
+};
+
+///compile-time layering (mixins): each layer inherits the layer it wraps -> the calls between layers are inlined, no virtual call and no heap allocation per layer
+template<typename Next>
+class ValidatedGrades: public Next{
+    public:
+        static constexpr double minGrade = 0.0;
+        static constexpr double maxGrade = 20.0;
+
+        void setGrades(Student* students, const double* grades, size_t n){ //the whole batch is checked before anything is written
+            for (size_t k = 0; k < n; k++){
+                if (!(grades[k] >= minGrade && grades[k] <= maxGrade)){
+                    throw invalid_argument("grade out of range for " + students[k].getName());
+                }
+            }
+            Next::setGrades(students, grades, n);
+        }
+};
+
+template<typename Next>
+class AuditedGrades: public Next{
+    size_t batches = 0;
+    size_t updates = 0;
+    public:
+        void setGrades(Student* students, const double* grades, size_t n){
+            batches++;
+            updates += n;
+            Next::setGrades(students, grades, n);
+        }
+
+        size_t getBatches() const { return batches; }
+        size_t getUpdates() const { return updates; }
+};
+
+template<typename Next>
+class PersistedGrades: public Next{
+    string journal; //stand-in for a file or a database: one append per batch
+    public:
+        void setGrades(Student* students, const double* grades, size_t n){
+            Next::setGrades(students, grades, n);
+            string batch;
+            for (size_t k = 0; k < n; k++){
+                batch += students[k].getName();
+                batch += ':';
+                batch += to_string(grades[k]);
+                batch += '\n';
+            }
+            journal += batch;
+        }
+
+        const string& getJournal() const { return journal; }
+};
+
+using GradePipeline = ValidatedGrades<AuditedGrades<PersistedGrades<GradeStore>>>;
+
+template<typename Chain>
+void setGrade(Chain& chain, Student& s, double grade){ //single update = batch of one
+    chain.setGrades(&s, &grade, 1);
+}
+
+///runtime layering: the same layers, chained through a virtual interface so the chain can be configured at runtime
+class GradeSink{
+    public:
+        virtual void setGrades(Student* students, const double* grades, size_t n) = 0;
+        virtual double getGrade(Student& s) = 0;
+        virtual ~GradeSink() = default;
+};
+
+class ForwardToSink{ //the Next of a runtime layer: forwards to whatever sink follows it in the chain
+    GradeSink* next = nullptr;
+    public:
+        void setNext(GradeSink* n){ next = n; }
+        void setGrades(Student* students, const double* grades, size_t n){ next->setGrades(students, grades, n); }
+        double getGrade(Student& s){ return next->getGrade(s); }
+};
+
+template<template<typename> class Layer>
+class RuntimeGradeLayer: public GradeSink{
+    Layer<ForwardToSink> layer;
+    public:
+        explicit RuntimeGradeLayer(GradeSink* next){ layer.setNext(next); }
+        void setGrades(Student* students, const double* grades, size_t n) override{ layer.setGrades(students, grades, n); }
+        double getGrade(Student& s) override{ return layer.getGrade(s); }
+};
+
+class GradeStoreSink: public GradeSink{
+    GradeStore store;
+    public:
+        void setGrades(Student* students, const double* grades, size_t n) override{ store.setGrades(students, grades, n); }
+        double getGrade(Student& s) override{ return store.getGrade(s); }
+};
+
+class GradeChain{ //built from a list of layer names, outermost first, e.g. {"validate", "audit", "persist"}
+    vector<unique_ptr<GradeSink>> layers; //layers.back() is the store
+    public:
+        explicit GradeChain(const vector<string>& names){
+            layers.push_back(make_unique<GradeStoreSink>());
+            for (auto it = names.rbegin(); it != names.rend(); ++it){
+                GradeSink* next = layers.back().get();
+                if (*it == "validate") layers.push_back(make_unique<RuntimeGradeLayer<ValidatedGrades>>(next));
+                else if (*it == "audit") layers.push_back(make_unique<RuntimeGradeLayer<AuditedGrades>>(next));
+                else if (*it == "persist") layers.push_back(make_unique<RuntimeGradeLayer<PersistedGrades>>(next));
+                else throw invalid_argument("unknown grade layer: " + *it);
+            }
+        }
+
+        void setGrades(Student* students, const double* grades, size_t n){ layers.back()->setGrades(students, grades, n); }
+        double getGrade(Student& s){ return layers.back()->getGrade(s); }
+};
+
 int main(){
     Student stu("Ayoub", 12.0); 
 
@@ -549,6 +1942,17 @@ int main(){
     double gr = dec.getGrade(stu);
     dec.setGrade(stu, 18.12);
 
+    vector<Student> students(1000, Student("Ayoub", 10.0));
+    vector<double> grades(students.size(), 15.5);
+
+    GradePipeline pipeline; //composed at compile time
+    pipeline.setGrades(students.data(), grades.data(), students.size()); //each layer sees one batch
+    setGrade(pipeline, stu, 19.0);
+    cout << pipeline.getGrade(stu) << " " << pipeline.getBatches() << "\n"; //19 2
+
+    GradeChain chain({"validate", "audit", "persist"}); //composed at runtime
+    chain.setGrades(students.data(), grades.data(), students.size());
+
     return 0;
 }
 
@@ -558,8 +1962,8 @@ int main(){
 class ObjectInterface{
     public:
         virtual ~ObjectInterface() = default;
-        virtual void getPrice() = 0;
-        virtual void getInfo() = 0;
+        virtual double getPrice() = 0; //values are returned (aggregated over groups) instead of printed
+        virtual string getInfo() = 0;
 }; 
 
 
@@ -571,12 +1975,19 @@ class Object: public ObjectInterface{
             this->price = p; 
         }
 
-        void getInfo() override{
-            cout << price << name;
+        string getInfo() override{
+            return to_string(price) + " " + name + "\n";
+        }
+
+        double getPrice() override {
+            return price;
         }
 
-        void getPrice() override {
-            cout << price;
+    private:
+        friend class FlatTree; //prices only change through Tree::setPrice / Tree::updatePrices, so the cached totals cannot go stale unnoticed
+        friend class Tree;
+        void setPrice(double p){
+            price = p;
         }
 }; 
 
@@ -586,71 +1997,370 @@ class ObjectGroup: public ObjectInterface{
     public:
         ObjectGroup(vector<Object*> objList, vector<ObjectGroup*> goList): objects(objList), groupObjects(goList){}
         
-        void getInfo() override{//base case of recursion is determined in runtime by the list attributes
+        string getInfo() override{//base case of recursion is determined in runtime by the list attributes
+            string info;
             for (Object* obj: objects){
-                obj->getInfo();
+                info += obj->getInfo();
             }
             for (ObjectGroup* objG: groupObjects){
-                objG->getInfo();
+                info += objG->getInfo();
             }
+            return info;
         }
-        void getPrice() override { //base case of recursion is determined in runtime by the list attributes
+        double getPrice() override { //base case of recursion is determined in runtime by the list attributes
+            double total = 0;
             for (Object* obj: objects){
-                obj->getPrice();
+                total += obj->getPrice();
             }
             for (ObjectGroup* objG: groupObjects){
-                objG->getPrice();
+                total += objG->getPrice();
             }
+            return total;
         }
+
+        const vector<Object*>& getObjects() const { return objects; }
+        const vector<ObjectGroup*>& getGroups() const { return groupObjects; }
 };
 
-class Tree{
-    int level;
-    int depth; 
-    ObjectInterface* OI; 
+//Flattened tree: the nodes are stored contiguously in pre-order (a subtree is the range [node, end) of the array) and every node caches the total price of its subtree
+///a whole-subtree query is O(1); a leaf price change adds the difference to the leaf's ancestors only (O(depth)) instead of recomputing everything
+struct FlatNode{
+    int parent; //-1 for the root
+    int end; //one past the last node of the subtree
+    Object* object; //nullptr for groups
+    ObjectGroup* group; //nullptr for leaves
+    double total; //cached subtree price
+};
+
+class FlatTree{
+    vector<FlatNode> nodes;
+    unordered_map<const ObjectInterface*, int> nodeOf;
+
+    int append(int parent, Object* obj, ObjectGroup* grp){
+        int id = static_cast<int>(nodes.size());
+        nodes.push_back(FlatNode{parent, id + 1, obj, grp, 0.0});
+        nodeOf[obj ? static_cast<const ObjectInterface*>(obj) : grp] = id;
+        return id;
+    }
+
+    double build(ObjectGroup* grp, int parent){ //pre-order: the group, its objects, then its subgroups
+        int id = append(parent, nullptr, grp);
+        double total = 0;
+        for (Object* obj: grp->getObjects()){
+            int leaf = append(id, obj, nullptr);
+            nodes[leaf].total = obj->getPrice();
+            total += nodes[leaf].total;
+        }
+        for (ObjectGroup* sub: grp->getGroups()){
+            total += build(sub, id);
+        }
+        nodes[id].total = total;
+        nodes[id].end = static_cast<int>(nodes.size());
+        return total;
+    }
     public:
-        Tree(int l, int d): level(l){
-            this->depth = d;
-        }; 
+        FlatTree() = default;
+        explicit FlatTree(ObjectGroup* root){
+            if (root) build(root, -1);
+        }
 
-        void readElement(){
-            OI->getInfo(); 
+        double subtreePrice(const ObjectInterface* node) const { //O(1)
+            return nodes[nodeOf.at(node)].total;
         }
 
-        void getPrices(){
-            OI->getPrice(); 
+        double totalPrice() const {
+            return nodes.empty() ? 0.0 : nodes[0].total;
         }
-};
 
+        void refresh(){ //recomputes every cached total from the leaves in one backward pass (children come after their parent), O(n)
+            for (FlatNode& n: nodes) if (!n.object) n.total = 0.0;
+            for (size_t k = nodes.size(); k-- > 0;){
+                if (nodes[k].object) nodes[k].total = nodes[k].object->getPrice();
+                if (nodes[k].parent >= 0) nodes[nodes[k].parent].total += nodes[k].total;
+            }
+        }
 
+        void setPrice(Object* obj, double price){ //incremental invalidation: only the ancestors of the leaf change
+            int id = nodeOf.at(obj);
+            double delta = price - obj->getPrice();
+            obj->setPrice(price);
+            for (; id != -1; id = nodes[id].parent){
+                nodes[id].total += delta;
+            }
+        }
 
-int main(){
+        const vector<FlatNode>& getNodes() const { return nodes; }
+};
 
+//Work-stealing scheduler: every thread owns a deque of tasks, pushes and pops at its back (newest first, cache-warm) and, when it runs dry, steals from the front of another thread's deque (oldest first, i.e. the biggest pieces of work)
+///the thread that calls TaskGroup::wait() also runs tasks while it waits, so nested fork/join (subtree inside subtree) never blocks a worker; tasks must not throw
+class WorkStealingPool{
+    struct WorkQueue{
+        mutex m;
+        deque<function<void()>> tasks;
+    };
+    vector<unique_ptr<WorkQueue>> queues; //queue 0 is shared by the threads that are not workers
+    vector<thread> workers;
+    atomic<size_t> queued{0};
+    mutex sleepMutex;
+    condition_variable wake;
+    bool stopping = false;
+
+    struct Current{ WorkStealingPool* pool; size_t index; };
+    static Current& current(){
+        thread_local Current c{nullptr, 0};
+        return c;
+    }
 
-    return 0; 
-}
+    size_t self(){
+        return current().pool == this ? current().index : 0;
+    }
 
-//Facade: the use of a simplified, limited but straightforward interface to a 3rd-party or secondary complex subsystem (library, framework or set of classes) without having to worry about their objects, execution order, dependency, etc => facade is a class-level encapsulation and abstraction (similar to an API endpoint)
+    bool popOwn(size_t q, function<void()>& task){
+        lock_guard<mutex> lock(queues[q]->m);
+        if (queues[q]->tasks.empty()) return false;
+        task = std::move(queues[q]->tasks.back());
+        queues[q]->tasks.pop_back();
+        return true;
+    }
 
-class Client{
-    string name;
-    Facade* f;
+    bool steal(size_t q, function<void()>& task){
+        lock_guard<mutex> lock(queues[q]->m);
+        if (queues[q]->tasks.empty()) return false;
+        task = std::move(queues[q]->tasks.front());
+        queues[q]->tasks.pop_front();
+        return true;
+    }
+
+    void workerLoop(size_t index){
+        current() = Current{this, index};
+        while (true){
+            if (runOne()) continue;
+            unique_lock<mutex> lock(sleepMutex);
+            wake.wait(lock, [this](){ return stopping || queued.load() > 0; });
+            if (stopping && queued.load() == 0) return;
+        }
+    }
     public:
-        Client(string n): name(n){}
-        void makeRequest(string request){
-            cout << "Client made a request " << request; 
-            string type = f->interpretRequest(request);
-            if (type == "Warehouse"){
-                f = new Warehouse(11,"Warehouse1", 20); 
-                f->handleRequest(request);
-            } else if (type == "Delivery"){
-                f = new Delivery(11,"Delivery1", 20); 
-                f->handleRequest(request);
-            } else {
-                cout << "invalid request"; //this part can be handled by an additional facade that handles unrelated requests, functionalities or features
+        explicit WorkStealingPool(unsigned nThreads){ //nThreads - 1 workers + the calling thread
+            nThreads = max(1u, nThreads);
+            for (unsigned k = 0; k < nThreads; k++) queues.push_back(make_unique<WorkQueue>());
+            for (unsigned k = 1; k < nThreads; k++) workers.emplace_back(&WorkStealingPool::workerLoop, this, k);
+        }
+        WorkStealingPool(const WorkStealingPool&) = delete;
+        WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+        ~WorkStealingPool(){
+            {
+                lock_guard<mutex> lock(sleepMutex);
+                stopping = true;
             }
+            wake.notify_all();
+            for (thread& w: workers) w.join();
         }
-}; 
+
+        void push(function<void()> task){
+            size_t q = self();
+            {
+                lock_guard<mutex> lock(queues[q]->m);
+                queues[q]->tasks.push_back(std::move(task));
+            }
+            queued++;
+            { lock_guard<mutex> lock(sleepMutex); } //a worker between its check and its wait holds sleepMutex -> no lost wake-up
+            wake.notify_one();
+        }
+
+        bool runOne(){ //own queue first, then steal round-robin
+            function<void()> task;
+            size_t me = self();
+            bool found = popOwn(me, task);
+            for (size_t k = 1; !found && k < queues.size(); k++){
+                found = steal((me + k) % queues.size(), task);
+            }
+            if (!found) return false;
+            queued--;
+            task();
+            return true;
+        }
+
+        size_t size() const { return queues.size(); }
+};
+
+class TaskGroup{ //fork/join on a pool
+    WorkStealingPool& pool;
+    atomic<size_t> pending{0};
+    public:
+        explicit TaskGroup(WorkStealingPool& p): pool(p){}
+        ~TaskGroup(){ wait(); }
+
+        template<typename F>
+        void run(F f){
+            pending++;
+            pool.push([this, f](){
+                f();
+                pending--;
+            });
+        }
+
+        void wait(){ //helps with other tasks instead of blocking
+            while (pending.load() != 0){
+                if (!pool.runOne()) this_thread::yield();
+            }
+        }
+};
+
+//Parallel traversal: one task per subgroup, large leaf vectors are split into chunks of `grain` objects
+///deterministic: the partial results are combined in the tree's own order (objects chunk by chunk, then subgroups) so the shape of the reduction depends on the tree and the grain, never on the thread count or on which thread ran what
+template<typename T, typename Map, typename Combine>
+T parallelReduce(WorkStealingPool& pool, ObjectGroup* group, T identity, Map map, Combine op, size_t grain = 4096){
+    const vector<Object*>& objs = group->getObjects();
+    const vector<ObjectGroup*>& subs = group->getGroups();
+    size_t chunks = (objs.size() + grain - 1) / grain;
+    vector<T> partial(chunks + subs.size(), identity);
+    auto reduceChunk = [&, grain](size_t c){
+        T acc = identity;
+        size_t end = min(objs.size(), (c + 1) * grain);
+        for (size_t k = c * grain; k < end; k++) acc = op(acc, map(*objs[k]));
+        partial[c] = acc;
+    };
+    {
+        TaskGroup tasks(pool);
+        for (size_t s = 0; s < subs.size(); s++){
+            tasks.run([&, s](){ partial[chunks + s] = parallelReduce(pool, subs[s], identity, map, op, grain); });
+        }
+        for (size_t c = 1; c < chunks; c++){
+            tasks.run([&reduceChunk, c](){ reduceChunk(c); });
+        }
+        if (chunks > 0) reduceChunk(0); //the current thread keeps a piece for itself
+        tasks.wait();
+    }
+    T acc = identity;
+    for (const T& p: partial) acc = op(acc, p);
+    return acc;
+}
+
+template<typename F>
+void parallelForEach(WorkStealingPool& pool, ObjectGroup* group, F fn, size_t grain = 4096){
+    parallelReduce(pool, group, 0, [&fn](Object& obj){ fn(obj); return 0; }, [](int, int){ return 0; }, grain);
+}
+
+class Tree{
+    int level;
+    int depth; 
+    ObjectInterface* OI = nullptr; 
+    ObjectGroup* root = nullptr;
+    mutable FlatTree flat;
+    mutable bool dirty = false; //set by bulk updates, the totals are refreshed on the next query (queries are not thread-safe while dirty)
+    const FlatTree& totals() const {
+        if (dirty){
+            flat.refresh();
+            dirty = false;
+        }
+        return flat;
+    }
+    public:
+        Tree(int l, int d): level(l){
+            this->depth = d;
+        }; 
+
+        Tree(int l, int d, ObjectGroup* r): level(l), OI(r), root(r), flat(r){
+            this->depth = d;
+        }
+
+        void readElement(){
+            cout << OI->getInfo(); 
+        }
+
+        void getPrices(){
+            cout << OI->getPrice(); 
+        }
+
+        double getTotalPrice() const { //O(1), from the cached root total
+            return totals().totalPrice();
+        }
+
+        double getSubtreePrice(const ObjectInterface* node) const {
+            return totals().subtreePrice(node);
+        }
+
+        void setPrice(Object* obj, double price){
+            flat.setPrice(obj, price);
+        }
+
+        const FlatTree& getFlatTree() const { return totals(); }
+
+        //parallel traversal of the object tree, e.g. reduce(pool, 0.0, [](Object& o){ return o.getPrice(); }, plus<double>())
+        template<typename T, typename Map, typename Combine>
+        T reduce(WorkStealingPool& pool, T identity, Map map, Combine op, size_t grain = 4096){
+            return root ? parallelReduce(pool, root, identity, map, op, grain) : identity;
+        }
+
+        template<typename F>
+        void forEach(WorkStealingPool& pool, F fn, size_t grain = 4096){
+            if (root) parallelForEach(pool, root, fn, grain);
+        }
+
+        //bulk repricing, e.g. updatePrices(pool, [](Object& o){ return o.getPrice() * 0.9; }): the leaves are written in parallel and the O(n) refresh of the totals is deferred to the next query, so several passes pay for it once
+        template<typename F>
+        void updatePrices(WorkStealingPool& pool, F newPrice, size_t grain = 4096){
+            if (!root) return;
+            parallelForEach(pool, root, [&newPrice](Object& o){ o.setPrice(newPrice(o)); }, grain);
+            dirty = true;
+        }
+};
+
+//scaling benchmark: total price of a catalog of nGroups x leavesPerGroup objects on 1, 2, 4, ... cores
+void benchParallelComposite(int nGroups, int leavesPerGroup){
+    vector<unique_ptr<Object>> storage;
+    vector<unique_ptr<ObjectGroup>> groups;
+    vector<ObjectGroup*> children;
+    for (int g = 0; g < nGroups; g++){
+        vector<Object*> leaves;
+        for (int k = 0; k < leavesPerGroup; k++){
+            storage.push_back(make_unique<Object>("item", (k % 100) * 0.25));
+            leaves.push_back(storage.back().get());
+        }
+        groups.push_back(make_unique<ObjectGroup>(leaves, vector<ObjectGroup*>{}));
+        children.push_back(groups.back().get());
+    }
+    ObjectGroup catalog({}, children);
+    Tree tree(0, 2, &catalog);
+
+    unsigned maxThreads = max(1u, thread::hardware_concurrency());
+    for (unsigned n = 1; n <= maxThreads; n *= 2){
+        WorkStealingPool pool(n);
+        auto start = chrono::steady_clock::now();
+        double total = tree.reduce(pool, 0.0, [](Object& o){ return o.getPrice(); }, plus<double>());
+        auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << n << " threads: " << elapsed << " ms (total " << total << ")\n";
+    }
+}
+
+
+
+int main(){
+    Object pen("pen", 1.5), book("book", 12.0), lamp("lamp", 30.0);
+    ObjectGroup stationery({&pen, &book}, {});
+    ObjectGroup catalog({&lamp}, {&stationery});
+
+    Tree tree(0, 2, &catalog);
+    double total = tree.getTotalPrice(); //43.5
+    tree.setPrice(&book, 10.0); //updates stationery and catalog totals only
+    double sub = tree.getSubtreePrice(&stationery); //11.5
+    cout << total << " " << sub << " " << tree.getTotalPrice() << " == " << catalog.getPrice();
+
+    WorkStealingPool pool(thread::hardware_concurrency());
+    double parallelTotal = tree.reduce(pool, 0.0, [](Object& o){ return o.getPrice(); }, plus<double>());
+    tree.updatePrices(pool, [](Object& o){ return o.getPrice() * 0.9; }); //10% discount, applied in parallel
+    cout << " " << parallelTotal << " -> " << tree.getTotalPrice() << "\n"; //41.5 -> 37.35
+
+    benchParallelComposite(200, 5000); //1M leaves: large enough to scale, small enough to build in a moment
+
+    return 0; 
+}
+
+//Facade: the use of a simplified, limited but straightforward interface to a 3rd-party or secondary complex subsystem (library, framework or set of classes) without having to worry about their objects, execution order, dependency, etc => facade is a class-level encapsulation and abstraction (similar to an API endpoint)
+
 class Facade{
     public:
         //interpretation of request
@@ -664,7 +2374,7 @@ class Facade{
             }
         }
         //delegation of request
-        virtual void handleRequest(string request) = 0;
+        virtual void handleRequest(string_view request) = 0;
         virtual ~Facade() = default;
 
 }; 
@@ -677,7 +2387,7 @@ class Warehouse: public Facade{
     public:
         Warehouse(int c, string n, int cap): code(c), name(n), capacity(cap){}
 
-        void handleRequest(string request) override{
+        void handleRequest(string_view request) override{
             cout << "Warehouse request handled!";
         }
 }; 
@@ -689,15 +2399,308 @@ class Delivery: public Facade{
     public:
         Delivery(int c, string n, int s): code(c), name(n), speed(s){}
 
-        void handleRequest(string request) override{
+        void handleRequest(string_view request) override{
             cout << "Delivery request handled!";            
         }
     
 };
 
+//Routing: the request patterns are compiled once into an open-addressing hash table (power-of-two size, linear probing) that maps a pattern to a long-lived subsystem handler
+///a request is routed by string_view: one hash + one compare on average, no copy and no allocation; handlers are created once and reused for every request
+class FacadeRouter{
+    struct Slot{
+        string_view pattern; //views into patterns (stable addresses)
+        Facade* handler = nullptr;
+    };
+    deque<string> patterns;
+    vector<unique_ptr<Facade>> handlers; //owned subsystems
+    vector<pair<size_t, Facade*>> routes; //every route added so far, in order: compile() rebuilds the whole table from them (a later route for the same pattern wins)
+    vector<Slot> table;
+    size_t mask = 0;
+    public:
+        FacadeRouter() = default;
+        FacadeRouter(const FacadeRouter&) = delete; //the table holds views into patterns
+        FacadeRouter& operator=(const FacadeRouter&) = delete;
+
+        Facade* addHandler(unique_ptr<Facade> h){
+            handlers.push_back(std::move(h));
+            return handlers.back().get();
+        }
+
+        void addRoute(string pattern, Facade* handler){
+            patterns.push_back(std::move(pattern));
+            routes.emplace_back(patterns.size() - 1, handler);
+        }
+
+        void compile(){ //rebuilds the table from all the routes, with at most 50% load: call once after the last addRoute()
+            size_t n = routes.size();
+            size_t capacity = 4;
+            while (capacity < 2 * n) capacity *= 2;
+            table.assign(capacity, Slot{});
+            mask = capacity - 1;
+            for (const auto& route: routes){
+                string_view p = patterns[route.first];
+                size_t k = hash<string_view>()(p) & mask;
+                while (table[k].handler != nullptr && table[k].pattern != p) k = (k + 1) & mask;
+                table[k] = Slot{p, route.second};
+            }
+        }
+
+        Facade* route(string_view request) const { //nullptr for an unknown request
+            if (table.empty()) return nullptr;
+            size_t k = hash<string_view>()(request) & mask;
+            while (table[k].handler != nullptr){
+                if (table[k].pattern == request) return table[k].handler;
+                k = (k + 1) & mask;
+            }
+            return nullptr;
+        }
+
+        bool dispatch(string_view request) const {
+            Facade* f = route(request);
+            if (f == nullptr) return false;
+            f->handleRequest(request);
+            return true;
+        }
+
+        static const FacadeRouter& standard(){ //the warehouse/delivery routes, built once (thread-safe static initialization)
+            static const unique_ptr<FacadeRouter> router = [](){
+                auto r = make_unique<FacadeRouter>();
+                Facade* warehouse = r->addHandler(make_unique<Warehouse>(11, "Warehouse1", 20));
+                Facade* delivery = r->addHandler(make_unique<Delivery>(11, "Delivery1", 20));
+                r->addRoute("I want to deliver something", delivery);
+                r->addRoute("I want to store something", warehouse);
+                r->compile();
+                return r;
+            }();
+            return *router;
+        }
+};
+
+class Client{
+    string name;
+    const FacadeRouter* router; //shared, long-lived handlers instead of one new Facade per request
+    public:
+        Client(string n): name(n), router(&FacadeRouter::standard()){}
+        Client(string n, const FacadeRouter& r): name(n), router(&r){}
+
+        void makeRequest(string_view request){
+            cout << "Client made a request " << request; 
+            if (!router->dispatch(request)){
+                cout << "invalid request"; //this part can be handled by an additional facade that handles unrelated requests, functionalities or features
+            }
+        }
+}; 
+
+//benchmark: n requests routed by string compares + one new subsystem per request (former Client::makeRequest) vs the precompiled route table
+void benchFacadeRouting(long n){
+    const string requests[3] = {"I want to deliver something", "I want to store something", "I want to fly"};
+    const FacadeRouter& router = FacadeRouter::standard();
+    Warehouse interpreter(0, "", 0); //only used for interpretRequest
+    streambuf* out = cout.rdbuf(nullptr); //silence the handlers so only routing is measured
+    long handled = 0;
+
+    auto start = chrono::steady_clock::now();
+    for (long i = 0; i < n; i++){
+        const string& request = requests[i % 3];
+        string type = interpreter.interpretRequest(request);
+        Facade* f = nullptr;
+        if (type == "Warehouse") f = new Warehouse(11, "Warehouse1", 20);
+        else if (type == "Delivery") f = new Delivery(11, "Delivery1", 20);
+        if (f){
+            f->handleRequest(request);
+            handled++;
+            delete f;
+        }
+    }
+    auto middle = chrono::steady_clock::now();
+    for (long i = 0; i < n; i++){
+        handled += router.dispatch(requests[i % 3]);
+    }
+    auto end = chrono::steady_clock::now();
+    cout.rdbuf(out);
+    cout.clear();
+
+    double legacyS = chrono::duration<double>(middle - start).count();
+    double routedS = chrono::duration<double>(end - middle).count();
+    cout << n << " requests: legacy " << n / legacyS / 1e6 << " M req/s, route table " << n / routedS / 1e6 << " M req/s (" << handled << " handled)\n";
+}
+
+//Concurrent facade: requests are enqueued into a bounded MPMC queue per subsystem and served by that subsystem's own worker pool, so a slow subsystem can't stall the callers or the other subsystems
+///when a queue is full the caller either waits (Block: backpressure) or the request is dropped and counted (Shed: load shedding)
+enum class OverflowPolicy { Block, Shed };
+
+template<typename T>
+class BoundedQueue{ //multi-producer multi-consumer ring guarded by one mutex
+    vector<T> ring;
+    size_t head = 0, count = 0;
+    bool closed = false;
+    mutable mutex m;
+    condition_variable notEmpty, notFull;
+    public:
+        explicit BoundedQueue(size_t capacity): ring(max<size_t>(1, capacity)){}
+
+        bool push(T item, OverflowPolicy policy){ //false when shed or closed
+            unique_lock<mutex> lock(m);
+            if (policy == OverflowPolicy::Block) notFull.wait(lock, [this](){ return count < ring.size() || closed; });
+            if (closed || count == ring.size()) return false;
+            ring[(head + count) % ring.size()] = std::move(item);
+            count++;
+            notEmpty.notify_one();
+            return true;
+        }
+
+        bool pop(T& item){ //blocks, false once the queue is closed and empty
+            unique_lock<mutex> lock(m);
+            notEmpty.wait(lock, [this](){ return count > 0 || closed; });
+            if (count == 0) return false;
+            item = std::move(ring[head]);
+            head = (head + 1) % ring.size();
+            count--;
+            notFull.notify_one();
+            return true;
+        }
+
+        void close(){
+            lock_guard<mutex> lock(m);
+            closed = true;
+            notEmpty.notify_all();
+            notFull.notify_all();
+        }
+
+        size_t size() const {
+            lock_guard<mutex> lock(m);
+            return count;
+        }
+};
+
+struct SubsystemMetrics{
+    double p50Us; //enqueue -> handled latency, over the last samples
+    double p99Us;
+    size_t queueDepth;
+    size_t maxQueueDepth;
+    size_t processed;
+    size_t shed;
+};
+
+class SubsystemPool{
+    struct Job{
+        string request;
+        chrono::steady_clock::time_point enqueued;
+    };
+    Facade* handler;
+    OverflowPolicy policy;
+    BoundedQueue<Job> queue;
+    vector<thread> workers;
+    atomic<size_t> processed{0}, shed{0}, maxDepth{0};
+    mutable mutex sampleMutex;
+    vector<double> samples; //ring of the last latencies in microseconds
+    size_t nextSample = 0;
+    static constexpr size_t maxSamples = 8192;
+
+    void serve(){
+        Job job;
+        while (queue.pop(job)){
+            handler->handleRequest(job.request);
+            double us = chrono::duration<double, micro>(chrono::steady_clock::now() - job.enqueued).count();
+            processed++;
+            lock_guard<mutex> lock(sampleMutex);
+            if (samples.size() < maxSamples) samples.push_back(us);
+            else samples[nextSample] = us;
+            nextSample = (nextSample + 1) % maxSamples;
+        }
+    }
+    public:
+        SubsystemPool(Facade* h, unsigned nThreads, size_t capacity, OverflowPolicy p): handler(h), policy(p), queue(capacity){
+            for (unsigned k = 0; k < max(1u, nThreads); k++) workers.emplace_back(&SubsystemPool::serve, this);
+        }
+
+        ~SubsystemPool(){ //queued requests are still served
+            queue.close();
+            for (thread& w: workers) w.join();
+        }
+
+        bool submit(string_view request){
+            if (!queue.push(Job{string(request), chrono::steady_clock::now()}, policy)){
+                shed++;
+                return false;
+            }
+            size_t depth = queue.size();
+            size_t seen = maxDepth.load();
+            while (depth > seen && !maxDepth.compare_exchange_weak(seen, depth)){}
+            return true;
+        }
+
+        SubsystemMetrics metrics() const {
+            vector<double> sorted;
+            {
+                lock_guard<mutex> lock(sampleMutex);
+                sorted = samples;
+            }
+            auto percentile = [&sorted](double q){
+                if (sorted.empty()) return 0.0;
+                size_t k = min(sorted.size() - 1, static_cast<size_t>(q * sorted.size()));
+                nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+                return sorted[k];
+            };
+            double p50 = percentile(0.50);
+            double p99 = percentile(0.99);
+            return SubsystemMetrics{p50, p99, queue.size(), maxDepth.load(), processed.load(), shed.load()};
+        }
+};
+
+class ConcurrentFacade{
+    const FacadeRouter& router;
+    unordered_map<const Facade*, unique_ptr<SubsystemPool>> pools;
+    public:
+        explicit ConcurrentFacade(const FacadeRouter& r): router(r){}
+
+        void addSubsystem(Facade* handler, unsigned nThreads, size_t capacity, OverflowPolicy policy){ //call before submitting
+            pools[handler] = make_unique<SubsystemPool>(handler, nThreads, capacity, policy);
+        }
+
+        bool submit(string_view request){ //thread-safe; false for an unknown request or a shed one
+            Facade* f = router.route(request);
+            if (f == nullptr) return false;
+            auto it = pools.find(f);
+            return it != pools.end() && it->second->submit(request);
+        }
+
+        SubsystemMetrics metrics(const Facade* handler) const {
+            return pools.at(handler)->metrics();
+        }
+};
+
 int main(){
     Client cl("Ayoub");
     cl.makeRequest("I want to deliver something"); 
+    benchFacadeRouting(10000000);
+
+    //concurrent mode: several clients, one worker pool per subsystem
+    const FacadeRouter& router = FacadeRouter::standard();
+    Facade* delivery = router.route("I want to deliver something");
+    Facade* warehouse = router.route("I want to store something");
+    streambuf* out = cout.rdbuf(nullptr);
+    SubsystemMetrics dm, wm;
+    {
+        ConcurrentFacade cf(router);
+        cf.addSubsystem(delivery, 2, 1024, OverflowPolicy::Block); //deliveries must not be lost
+        cf.addSubsystem(warehouse, 1, 256, OverflowPolicy::Shed); //storage requests are shed under overload
+        vector<thread> clients;
+        for (int c = 0; c < 4; c++){
+            clients.emplace_back([&cf](){
+                for (int i = 0; i < 10000; i++){
+                    cf.submit(i % 2 ? "I want to deliver something" : "I want to store something");
+                }
+            });
+        }
+        for (thread& c: clients) c.join();
+        dm = cf.metrics(delivery);
+        wm = cf.metrics(warehouse);
+    }
+    cout.rdbuf(out);
+    cout.clear();
+    cout << "Delivery p50 " << dm.p50Us << " us, p99 " << dm.p99Us << " us, max depth " << dm.maxQueueDepth << "; Warehouse p50 " << wm.p50Us << " us, p99 " << wm.p99Us << " us, shed " << wm.shed << "\n";
     return 0;
 }
 
@@ -714,35 +2717,437 @@ class Particle{ //the Flyweight class is the class that stores immutable intrins
     string type;
     string shape;
     public:
-        Particle(string t, string c, string sh): type(t), color(c), shape(sh){} //extrinsic mutable states
+        Particle(string t, string c, string sh): color(c), type(t), shape(sh){} //extrinsic mutable states
 
-        string getShape(){
+        string getShape() const {
             return this->shape;
         }
+        const string& getType() const { return type; }
+        const string& getColor() const { return color; }
+
+        size_t memoryBytes() const { //inline size + heap owned by the strings
+            return sizeof(Particle) + heapBytes(color) + heapBytes(type) + heapBytes(shape);
+        }
     
 };
 
+//Flyweight factory: every distinct (type, color, shape) tuple is stored once and identified by a 32-bit index
+struct ParticleType{
+    string type;
+    string color;
+    string shape;
+};
+
+class ParticleFactory{
+    static constexpr uint32_t empty = UINT32_MAX;
+    struct Slot{
+        size_t hash;
+        uint32_t id = empty;
+    };
+    vector<ParticleType> types; //index -> intrinsic state
+    vector<Slot> table; //open addressing over the types, at most 50% load: a lookup hashes and compares the views, no key string is built
+    size_t mask = 0;
+
+    static size_t hashKey(string_view type, string_view color, string_view shape){
+        hash<string_view> h;
+        size_t k = h(type);
+        k ^= h(color) + 0x9e3779b97f4a7c15ull + (k << 6) + (k >> 2);
+        k ^= h(shape) + 0x9e3779b97f4a7c15ull + (k << 6) + (k >> 2);
+        return k;
+    }
+
+    void grow(){ //doubles the table and reinserts the stored hashes
+        vector<Slot> old(max<size_t>(16, 2 * table.size()));
+        old.swap(table);
+        mask = table.size() - 1;
+        for (const Slot& slot: old){
+            if (slot.id == empty) continue;
+            size_t k = slot.hash & mask;
+            while (table[k].id != empty) k = (k + 1) & mask;
+            table[k] = slot;
+        }
+    }
+    public:
+        uint32_t intern(string_view type, string_view color, string_view shape){
+            if (2 * (types.size() + 1) > table.size()) grow();
+            size_t h = hashKey(type, color, shape);
+            size_t k = h & mask;
+            while (table[k].id != empty){
+                const ParticleType& t = types[table[k].id];
+                if (table[k].hash == h && t.type == type && t.color == color && t.shape == shape) return table[k].id;
+                k = (k + 1) & mask;
+            }
+            uint32_t id = static_cast<uint32_t>(types.size());
+            types.push_back(ParticleType{string(type), string(color), string(shape)});
+            table[k] = Slot{h, id};
+            return id;
+        }
+
+        uint32_t intern(const Particle& p){
+            return intern(p.getType(), p.getColor(), p.getShape());
+        }
+
+        const ParticleType& get(uint32_t id) const {
+            return types[id];
+        }
+
+        size_t size() const {
+            return types.size();
+        }
+
+        size_t memoryBytes() const { //approximate: tuples stored once, plus the table
+            size_t bytes = sizeof(*this) + types.capacity() * sizeof(ParticleType) + table.capacity() * sizeof(Slot);
+            for (const ParticleType& t: types) bytes += t.type.size() + t.color.size() + t.shape.size() + 3;
+            return bytes;
+        }
+};
+
+//Context: only the extrinsic state travels with each particle, the intrinsic state is reached through the flyweight index
+///array-of-structs layout, kept as the baseline of benchParticleUpdate: the Game itself stores its contexts field by field in a ParticleStore
+struct ParticleContext{
+    float x, y;
+    float vx, vy;
+    uint32_t flyweight;
+};
+
+//SoA particle store: one aligned array per field (x, y, vx, vy, flyweight index) so the integrate kernel streams through contiguous floats 8 (AVX2) or 4 (SSE) at a time
+///the kernel is chosen once at runtime from the CPU features (scalar fallback everywhere else); a dead particle is replaced by the last one (swap-remove) so the arrays stay dense
+template<typename T, size_t Align = 64>
+struct AlignedAllocator{
+    using value_type = T;
+    template<typename U> struct rebind{ using other = AlignedAllocator<U, Align>; };
+    AlignedAllocator() = default;
+    template<typename U> AlignedAllocator(const AlignedAllocator<U, Align>&){}
+    T* allocate(size_t n){ return static_cast<T*>(::operator new(n * sizeof(T), align_val_t(Align))); }
+    void deallocate(T* p, size_t){ ::operator delete(p, align_val_t(Align)); }
+    template<typename U> bool operator==(const AlignedAllocator<U, Align>&) const { return true; }
+    template<typename U> bool operator!=(const AlignedAllocator<U, Align>&) const { return false; }
+};
+
+using AlignedFloats = vector<float, AlignedAllocator<float>>;
+using IntegrateKernel = void (*)(float* x, float* y, const float* vx, const float* vy, size_t n, float dt);
+
+static void integrateScalar(float* __restrict x, float* __restrict y, const float* __restrict vx, const float* __restrict vy, size_t n, float dt){
+    for (size_t k = 0; k < n; k++){
+        x[k] += vx[k] * dt;
+        y[k] += vy[k] * dt;
+    }
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+__attribute__((target("sse2")))
+static void integrateSSE(float* x, float* y, const float* vx, const float* vy, size_t n, float dt){
+    __m128 d = _mm_set1_ps(dt);
+    size_t k = 0;
+    for (; k + 4 <= n; k += 4){ //arrays are 64-byte aligned: aligned loads/stores
+        _mm_store_ps(x + k, _mm_add_ps(_mm_load_ps(x + k), _mm_mul_ps(_mm_load_ps(vx + k), d)));
+        _mm_store_ps(y + k, _mm_add_ps(_mm_load_ps(y + k), _mm_mul_ps(_mm_load_ps(vy + k), d)));
+    }
+    integrateScalar(x + k, y + k, vx + k, vy + k, n - k, dt);
+}
+
+__attribute__((target("avx2")))
+static void integrateAVX2(float* x, float* y, const float* vx, const float* vy, size_t n, float dt){
+    __m256 d = _mm256_set1_ps(dt);
+    size_t k = 0;
+    for (; k + 8 <= n; k += 8){
+        _mm256_store_ps(x + k, _mm256_add_ps(_mm256_load_ps(x + k), _mm256_mul_ps(_mm256_load_ps(vx + k), d)));
+        _mm256_store_ps(y + k, _mm256_add_ps(_mm256_load_ps(y + k), _mm256_mul_ps(_mm256_load_ps(vy + k), d)));
+    }
+    integrateScalar(x + k, y + k, vx + k, vy + k, n - k, dt);
+}
+#endif
+
+class ParticleStore{
+    AlignedFloats x, y, vx, vy;
+    vector<uint32_t> flyweight;
+    IntegrateKernel kernel;
+    const char* kernelName;
+    public:
+        ParticleStore(){
+            kernel = integrateScalar;
+            kernelName = "scalar";
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2")){
+                kernel = integrateAVX2;
+                kernelName = "avx2";
+            } else if (__builtin_cpu_supports("sse2")){
+                kernel = integrateSSE;
+                kernelName = "sse2";
+            }
+#endif
+        }
+
+        size_t add(float px, float py, float pvx, float pvy, uint32_t fw){ //returns the particle's slot
+            x.push_back(px);
+            y.push_back(py);
+            vx.push_back(pvx);
+            vy.push_back(pvy);
+            flyweight.push_back(fw);
+            return flyweight.size() - 1;
+        }
+
+        void remove(size_t slot){ //swap-remove: the last particle takes the slot (slots are not stable across removals)
+            size_t last = flyweight.size() - 1;
+            x[slot] = x[last]; y[slot] = y[last];
+            vx[slot] = vx[last]; vy[slot] = vy[last];
+            flyweight[slot] = flyweight[last];
+            x.pop_back(); y.pop_back(); vx.pop_back(); vy.pop_back(); flyweight.pop_back();
+        }
+
+        void integrate(float dt){
+            kernel(x.data(), y.data(), vx.data(), vy.data(), flyweight.size(), dt);
+        }
+
+        void reserve(size_t n){
+            x.reserve(n); y.reserve(n); vx.reserve(n); vy.reserve(n); flyweight.reserve(n);
+        }
+
+        size_t size() const { return flyweight.size(); }
+        size_t memoryBytes() const { //capacity of the five arrays
+            return x.capacity() * sizeof(float) * 4 + flyweight.capacity() * sizeof(uint32_t);
+        }
+        float getX(size_t slot) const { return x[slot]; }
+        float getY(size_t slot) const { return y[slot]; }
+        uint32_t getFlyweight(size_t slot) const { return flyweight[slot]; }
+        const char* getKernelName() const { return kernelName; }
+};
+
+//Batched drawing: instead of one draw per particle, particles are bucketed by render state (shape + color: what the draw call actually depends on) and each bucket becomes one instanced draw (one record + a contiguous buffer of per-instance positions)
+///flyweights that differ only by type share a render state, hence a batch; bucketing is a counting sort on the render state index: O(particles + states), no per-frame allocation once the buffers have grown
+struct DrawInstance{
+    float x, y;
+};
+
+struct RenderState{
+    string shape;
+    string color;
+};
+
+struct DrawBatch{
+    uint32_t renderState;
+    const RenderState* state; //shared shape/color
+    const DrawInstance* instances; //contiguous, valid during submit() only
+    size_t count;
+};
+
+class DrawSink{ //renderer backend
+    public:
+        virtual void submit(const DrawBatch& batch) = 0;
+        virtual void endFrame(){}
+        virtual ~DrawSink() = default;
+};
+
+class ConsoleDrawSink: public DrawSink{
+    public:
+        void submit(const DrawBatch& batch) override{
+            cout << batch.count << " x " << batch.state->color << " " << batch.state->shape << " drawn\n";
+        }
+};
+
+class MemoryDrawSink: public DrawSink{ //keeps the submitted batches, for tests
+    public:
+        struct Record{
+            uint32_t renderState;
+            string shape;
+            string color;
+            vector<DrawInstance> instances;
+        };
+        vector<vector<Record>> frames; //completed frames
+        vector<Record> current;
+
+        void submit(const DrawBatch& batch) override{
+            current.push_back(Record{batch.renderState, batch.state->shape, batch.state->color, vector<DrawInstance>(batch.instances, batch.instances + batch.count)});
+        }
+        void endFrame() override{
+            frames.push_back(std::move(current));
+            current.clear();
+        }
+};
+
+struct DrawStats{
+    size_t frames = 0;
+    size_t batches = 0;
+    size_t instances = 0;
+    size_t lastFrameBatches = 0;
+
+    double batchesPerFrame() const { return frames ? static_cast<double>(batches) / frames : 0.0; }
+    double instancesPerBatch() const { return batches ? static_cast<double>(instances) / batches : 0.0; }
+};
+
+class DrawBatcher{ //bound to one ParticleFactory (the one of its Game)
+    vector<RenderState> states;
+    unordered_map<string, uint32_t> stateIds; //shape + '\0' + color -> index in states
+    vector<uint32_t> stateOf; //per flyweight: its render state
+    vector<size_t> offsets; //per render state: start of its bucket in instances
+    vector<DrawInstance> instances;
+    DrawStats stats;
+
+    void mapNewFlyweights(const ParticleFactory& factory){ //flyweights are only appended, so each one is looked up once
+        for (size_t f = stateOf.size(); f < factory.size(); f++){
+            const ParticleType& t = factory.get(static_cast<uint32_t>(f));
+            auto inserted = stateIds.emplace(t.shape + '\0' + t.color, static_cast<uint32_t>(states.size()));
+            if (inserted.second) states.push_back(RenderState{t.shape, t.color});
+            stateOf.push_back(inserted.first->second);
+        }
+    }
+    public:
+        void drawFrame(const ParticleStore& store, const ParticleFactory& factory, DrawSink& sink){
+            mapNewFlyweights(factory);
+            size_t kinds = states.size();
+            size_t n = store.size();
+            offsets.assign(kinds + 1, 0);
+            for (size_t k = 0; k < n; k++) offsets[stateOf[store.getFlyweight(k)] + 1]++;
+            for (size_t s = 0; s < kinds; s++) offsets[s + 1] += offsets[s];
+            instances.resize(n);
+            for (size_t k = 0; k < n; k++){
+                instances[offsets[stateOf[store.getFlyweight(k)]]++] = DrawInstance{store.getX(k), store.getY(k)};
+            }
+            //offsets[s] is now the end of bucket s, which is the start of bucket s + 1
+            size_t batches = 0;
+            size_t begin = 0;
+            for (size_t s = 0; s < kinds; s++){
+                size_t end = offsets[s];
+                if (end > begin){
+                    sink.submit(DrawBatch{static_cast<uint32_t>(s), &states[s], instances.data() + begin, end - begin});
+                    batches++;
+                }
+                begin = end;
+            }
+            sink.endFrame();
+            stats.frames++;
+            stats.batches += batches;
+            stats.instances += n;
+            stats.lastFrameBatches = batches;
+        }
+
+        const DrawStats& getStats() const { return stats; }
+};
+
 // the RAM cost problem comes from aggregation/composition of the Particle class in a Game class
 
 class Game{ //Flyweight factory
     string name;
     vector<Particle> particles;
+    ParticleFactory factory;
+    ParticleStore store; //flyweight-backed particles: extrinsic state in SoA form + flyweight index
+    DrawBatcher batcher;
     public:
         Game(string n, vector<Particle> pas): name(n), particles(pas){}
 
-        void addParticle(Particle p){
+        void addParticle(const Particle& p){
             particles.push_back(p);
         }
-        void drawParticle(Particle p){
+        void drawParticle(const Particle& p){
             cout << p.getShape() << "drawn"; 
         }
+
+        //flyweight path: the tuple is interned once, each particle only stores its extrinsic state + a 32-bit index; returns the particle's slot
+        size_t spawnParticle(string_view type, string_view color, string_view shape, float x, float y, float vx, float vy){
+            return store.add(x, y, vx, vy, factory.intern(type, color, shape));
+        }
+        size_t spawnParticle(const Particle& p, float x, float y, float vx, float vy){
+            return store.add(x, y, vx, vy, factory.intern(p));
+        }
+        void killParticle(size_t slot){
+            store.remove(slot);
+        }
+        void drawParticle(size_t slot){
+            cout << factory.get(store.getFlyweight(slot)).shape << "drawn at " << store.getX(slot) << "," << store.getY(slot); 
+        }
+
+        void reserve(size_t n){
+            store.reserve(n);
+        }
+
+        void update(float dt){ //vectorized over the SoA arrays
+            store.integrate(dt);
+        }
+
+        void drawFrame(DrawSink& sink){ //one instanced draw per render state
+            batcher.drawFrame(store, factory, sink);
+        }
+
+        const ParticleStore& getStore() const { return store; }
+        const DrawStats& getDrawStats() const { return batcher.getStats(); }
+
+        const ParticleFactory& getFactory() const { return factory; }
 };
 
+//memory per particle: n Particle objects (strings per instance) vs the store (extrinsic state + flyweight index) + the shared flyweights
+void benchParticleMemory(size_t n){
+    const Particle kinds[3] = {Particle("bullet", "red", "bulletShape"), Particle("bullet", "blue", "bulletShape"), Particle("missile", "blue", "missileShapeWithTrail")};
+    size_t before = 0;
+    {
+        vector<Particle> particles;
+        particles.reserve(n);
+        for (size_t i = 0; i < n; i++) particles.push_back(kinds[i % 3]);
+        before = particles.capacity() * sizeof(Particle);
+        for (const Particle& p: particles) before += p.memoryBytes() - sizeof(Particle);
+    }
+    Game game("bench", {});
+    game.reserve(n);
+    for (size_t i = 0; i < n; i++) game.spawnParticle(kinds[i % 3], 0.0f, 0.0f, 1.0f, 1.0f);
+    size_t after = game.getStore().memoryBytes() + game.getFactory().memoryBytes();
+    cout << n << " particles: " << static_cast<double>(before) / n << " bytes/particle before, " << static_cast<double>(after) / n << " bytes/particle with flyweights (" << game.getFactory().size() << " flyweights)\n";
+}
+
+//update throughput: AoS ParticleContext loop vs the Game's SoA store with the runtime-selected kernel
+void benchParticleUpdate(size_t n, int frames){
+    ParticleFactory factory;
+    vector<ParticleContext> aos;
+    Game soa("soa", {});
+    aos.reserve(n);
+    soa.reserve(n);
+    for (size_t i = 0; i < n; i++){
+        float v = static_cast<float>(i % 7);
+        aos.push_back(ParticleContext{0.0f, 0.0f, v, -v, factory.intern("bullet", "red", "bulletShape")});
+        soa.spawnParticle("bullet", "red", "bulletShape", 0.0f, 0.0f, v, -v);
+    }
+    auto start = chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++){
+        for (ParticleContext& c: aos){
+            c.x += c.vx * 0.016f;
+            c.y += c.vy * 0.016f;
+        }
+    }
+    auto middle = chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) soa.update(0.016f);
+    auto end = chrono::steady_clock::now();
+    double updates = static_cast<double>(n) * frames;
+    cout << "particles updated/s: AoS " << updates / chrono::duration<double>(middle - start).count() / 1e6 << " M, SoA (" << soa.getStore().getKernelName() << ") " << updates / chrono::duration<double>(end - middle).count() / 1e6 << " M (" << aos[1].x << " == " << soa.getStore().getX(1) << ")\n";
+}
+
 int main(){
     Particle redBullet("red", "bullet", "bulletShape");
     Particle blueBullet("blue", "bullet", "bulletShape");
 
     Particle blueMissile("blue", "missile", "missileShape"); 
+
+    Game game("shooter", {});
+    game.spawnParticle("bullet", "red", "bulletShape", 0.0f, 0.0f, 1.0f, 0.0f);
+    size_t second = game.spawnParticle("bullet", "red", "bulletShape", 5.0f, 2.0f, 1.0f, 0.0f); //same flyweight as the first one
+    game.drawParticle(second);
+
+    benchParticleMemory(10000000);
+
+    size_t slot = game.spawnParticle("missile", "blue", "missileShape", 0.0f, 0.0f, 2.0f, 1.0f);
+    game.spawnParticle("bullet", "red", "bulletShape", 1.0f, 1.0f, 1.0f, 0.0f);
+    game.update(0.016f);
+    game.killParticle(slot); //the bullet moves into the missile's slot
+
+    for (int i = 0; i < 1000; i++){
+        game.spawnParticle(i % 2 ? "bullet" : "missile", "red", i % 2 ? "bulletShape" : "missileShape", static_cast<float>(i), 0.0f, 1.0f, 0.0f);
+    }
+    game.spawnParticle("tracer", "red", "bulletShape", 0.0f, 0.0f, 3.0f, 0.0f); //another flyweight, same render state as the red bullets
+    ConsoleDrawSink screen;
+    game.drawFrame(screen); //2 draws instead of 1004
+    MemoryDrawSink recorder;
+    game.drawFrame(recorder);
+    cout << game.getDrawStats().batchesPerFrame() << " batches/frame, " << game.getDrawStats().instancesPerBatch() << " instances/batch\n";
+
+    benchParticleUpdate(1000000, 100);
     return 0;
 }
 
@@ -751,19 +3156,50 @@ int main(){
 ///Proxy also does caching of results to client/user requests so that in case of multiple similar requests, the proxy merely returns the cached result without delegation to the original service
 ///Proxy implements the Open-Closed principle: you can extend the service beahvior just by adding more proxies
 ///Proxy knows about the User and Service but they aren't aware of it
+class User;
+
+//Credentials are hashed once (when the user or service is created) and only digests are compared afterwards, in constant time
+///keyed FNV-1a with a per-process random salt and a 64-bit finalizer: a stand-in for a real password hash / HMAC, not a cryptographic hash
+struct CredentialDigest{
+    uint64_t words[2];
+};
+
+inline CredentialDigest hashCredentials(string_view credentials){
+    static const uint64_t salt[2] = { (uint64_t(random_device{}()) << 32) | random_device{}(), (uint64_t(random_device{}()) << 32) | random_device{}() };
+    CredentialDigest d;
+    for (int k = 0; k < 2; k++){
+        uint64_t h = 14695981039346656037ull ^ salt[k];
+        for (char c: credentials) h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        h ^= h >> 33; h *= 0xff51afd7ed558ccdull; //spread the last bytes over the whole word
+        h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ull;
+        d.words[k] = h ^ (h >> 33);
+    }
+    return d;
+}
+
+inline bool constantTimeEquals(const CredentialDigest& a, const CredentialDigest& b){ //no early exit: the time taken does not reveal where the digests differ
+    volatile uint64_t diff = 0;
+    for (int k = 0; k < 2; k++) diff = diff | (a.words[k] ^ b.words[k]);
+    return diff == 0;
+}
+
+class ServiceInterface{
+    public:
+        virtual void processRequest(string request, const User& user) = 0;
+        virtual ~ServiceInterface() = default;
+};
+
 class User{
     string name;
-    string credentials; 
-    ServiceInterface* SI;
+    CredentialDigest credentialDigest; //hashed once, the plaintext is not kept
+    ServiceInterface* SI = nullptr;
     public:
         User(string n, string cred){
             this->name = n;
-            this->credentials = cred;
+            this->credentialDigest = hashCredentials(cred);
         }
 
-        void chooseService(string name){
-            SI = new Proxy(name, 20);
-        }
+        void chooseService(string name); //defined after Proxy
         void makeRequest(string request){
             SI->processRequest(request, *this); 
         }
@@ -772,73 +3208,1110 @@ class User{
             return name;
         }
 
-        string getCredentials() const {
-            return credentials; 
+        const CredentialDigest& getCredentialDigest() const {
+            return credentialDigest;
         }
 }; 
 
-class ServiceInterface{
+
+class Service: public ServiceInterface{
+    string name; 
+    int size;
     public:
-        virtual void processRequest(string request, const User& user) = 0;
-        virtual ~ServiceInterface() = default;
+        Service(string n, int s): name(n), size(s){}
+
+        void processRequest(string request, const User& user) override{
+            cout << user.getName() << "Request processed!";
+        }
+
+        virtual string outputResult(string request){
+            return request + "processed!"; 
+        }
+
+        friend class Proxy; 
+};
+
+class SlowService: public Service{ //demo and benchmark stand-in for an expensive backend: each result takes `cost` to compute
+    chrono::microseconds cost;
+    public:
+        SlowService(string n, int s, chrono::microseconds c): Service(n, s), cost(c){}
+
+        string outputResult(string request) override{
+            this_thread::sleep_for(cost);
+            return Service::outputResult(request);
+        }
+};
+
+//Result cache of the caching proxy: keyed by request, O(1) lookup, bounded capacity with LRU or LFU eviction and an optional time-to-live
+///one structure serves both policies: keys are kept in per-frequency lists (most recent first) and the victim is the least recent key of the lowest frequency; under LRU the frequency is never bumped, so everything stays in one list
+enum class EvictionPolicy { LRU, LFU };
+
+struct CacheStats{
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t expirations = 0;
+};
+
+class ResultCache{
+    struct Entry{
+        string value;
+        size_t freq;
+        chrono::steady_clock::time_point expires;
+        list<string>::iterator pos; //position in buckets[freq]
+    };
+    unordered_map<string, Entry> entries;
+    unordered_map<size_t, list<string>> buckets; //frequency -> keys
+    size_t minFreq = 1;
+    size_t capacity;
+    EvictionPolicy policy;
+    chrono::milliseconds ttl; //0: entries never expire
+    CacheStats stats;
+
+    void unlink(Entry& e){
+        auto bucket = buckets.find(e.freq);
+        bucket->second.erase(e.pos);
+        if (bucket->second.empty()) buckets.erase(bucket);
+    }
+
+    void erase(unordered_map<string, Entry>::iterator it){
+        unlink(it->second);
+        entries.erase(it);
+    }
+
+    void touch(unordered_map<string, Entry>::iterator it){ //one use of the key: most recent of its bucket, and one frequency up under LFU
+        Entry& e = it->second;
+        size_t oldFreq = e.freq;
+        unlink(e);
+        if (policy == EvictionPolicy::LFU) e.freq++;
+        list<string>& bucket = buckets[e.freq];
+        bucket.push_front(it->first);
+        e.pos = bucket.begin();
+        if (minFreq == oldFreq && buckets.find(oldFreq) == buckets.end()) minFreq = e.freq;
+    }
+
+    void evict(){
+        if (buckets.find(minFreq) == buckets.end()){ //the lowest bucket was emptied by an expiration or a promotion: rescan (rare)
+            minFreq = SIZE_MAX;
+            for (const auto& b: buckets) minFreq = min(minFreq, b.first);
+        }
+        erase(entries.find(buckets[minFreq].back()));
+        stats.evictions++;
+    }
+    public:
+        ResultCache(size_t cap, EvictionPolicy p = EvictionPolicy::LRU, chrono::milliseconds t = chrono::milliseconds(0)): capacity(max<size_t>(1, cap)), policy(p), ttl(t){}
+
+        const string* get(const string& request){ //nullptr on a miss; the pointer is valid until the next put()
+            auto it = entries.find(request);
+            if (it == entries.end()){
+                stats.misses++;
+                return nullptr;
+            }
+            Entry& e = it->second;
+            if (ttl.count() > 0 && chrono::steady_clock::now() >= e.expires){
+                erase(it);
+                stats.expirations++;
+                stats.misses++;
+                return nullptr;
+            }
+            touch(it);
+            stats.hits++;
+            return &e.value;
+        }
+
+        void put(const string& request, string result){
+            auto it = entries.find(request);
+            if (it != entries.end()){ //overwrite: refresh the value and count it as a use, exactly like a hit
+                it->second.value = std::move(result);
+                it->second.expires = chrono::steady_clock::now() + ttl;
+                touch(it);
+                return;
+            }
+            if (entries.size() >= capacity) evict();
+            list<string>& bucket = buckets[1];
+            bucket.push_front(request);
+            entries.emplace(request, Entry{std::move(result), 1, chrono::steady_clock::now() + ttl, bucket.begin()});
+            minFreq = 1;
+        }
+
+        size_t size() const { return entries.size(); }
+        const CacheStats& getStats() const { return stats; }
+};
+
+//Request log of the logging proxy: a fixed-size lock-free ring of preallocated records (bounded MPMC queue, one sequence number per cell) filled by the request threads and drained by a background thread into a compact binary file
+///no allocation and no lock on the hot path; when the ring is full the record is either dropped and counted (Drop) or the caller spins until the drainer frees a cell (Block)
+///file format, one entry per request: uint64 timestamp (ns since the log was opened), uint16 length, then the request bytes (truncated to maxText)
+enum class LogOverflow { Drop, Block };
+
+class RequestLog{
+    static constexpr size_t maxText = 110;
+    struct Record{
+        uint64_t timestamp;
+        uint16_t length;
+        char text[maxText];
+    };
+    struct alignas(64) Cell{ //one cache line per record: producers on neighbouring cells don't false-share
+        atomic<size_t> sequence;
+        Record record;
+    };
+    unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) atomic<size_t> enqueuePos{0};
+    alignas(64) atomic<size_t> dequeuePos{0};
+    atomic<size_t> logged{0}, dropped{0}, truncated{0};
+    LogOverflow policy;
+    chrono::steady_clock::time_point opened;
+    FILE* out;
+    atomic<bool> stopping{false};
+    thread drainer;
+
+    bool tryPush(string_view request, uint64_t timestamp){
+        size_t pos = enqueuePos.load(memory_order_relaxed);
+        while (true){
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0){ //free cell for this lap: claim it
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)){
+                    size_t n = min(request.size(), maxText);
+                    cell.record.timestamp = timestamp;
+                    cell.record.length = static_cast<uint16_t>(n);
+                    memcpy(cell.record.text, request.data(), n);
+                    cell.sequence.store(pos + 1, memory_order_release); //publish to the consumer
+                    return true;
+                }
+            } else if (diff < 0){
+                return false; //full: the cell still holds last lap's record
+            } else {
+                pos = enqueuePos.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(Record& r){
+        size_t pos = dequeuePos.load(memory_order_relaxed);
+        while (true){
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0){
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)){
+                    r = cell.record;
+                    cell.sequence.store(pos + mask + 1, memory_order_release); //free for the next lap
+                    return true;
+                }
+            } else if (diff < 0){
+                return false; //empty
+            } else {
+                pos = dequeuePos.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    void drain(){
+        vector<char> buffer;
+        buffer.reserve(64 * 1024);
+        Record r;
+        while (true){
+            bool stop = stopping.load(memory_order_acquire);
+            while (tryPop(r)){
+                buffer.insert(buffer.end(), reinterpret_cast<const char*>(&r.timestamp), reinterpret_cast<const char*>(&r.timestamp) + sizeof(r.timestamp));
+                buffer.insert(buffer.end(), reinterpret_cast<const char*>(&r.length), reinterpret_cast<const char*>(&r.length) + sizeof(r.length));
+                buffer.insert(buffer.end(), r.text, r.text + r.length);
+                if (buffer.size() >= 60 * 1024){
+                    fwrite(buffer.data(), 1, buffer.size(), out);
+                    buffer.clear();
+                }
+            }
+            if (!buffer.empty()){
+                fwrite(buffer.data(), 1, buffer.size(), out);
+                buffer.clear();
+            }
+            if (stop) return; //the ring was emptied after stopping was seen
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+    }
+    public:
+        RequestLog(const string& path, size_t capacity = 4096, LogOverflow p = LogOverflow::Drop): policy(p), opened(chrono::steady_clock::now()){
+            size_t n = 2;
+            while (n < capacity) n *= 2; //power of two: index = position & mask
+            cells = make_unique<Cell[]>(n);
+            mask = n - 1;
+            for (size_t k = 0; k < n; k++) cells[k].sequence.store(k, memory_order_relaxed);
+            out = fopen(path.c_str(), "wb");
+            if (out == nullptr) throw runtime_error("cannot open request log " + path);
+            drainer = thread(&RequestLog::drain, this);
+        }
+        RequestLog(const RequestLog&) = delete;
+        RequestLog& operator=(const RequestLog&) = delete;
+
+        ~RequestLog(){ //everything logged before destruction reaches the file
+            stopping.store(true, memory_order_release);
+            drainer.join();
+            fclose(out);
+        }
+
+        bool log(string_view request){ //false if the record was dropped
+            uint64_t timestamp = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - opened).count();
+            if (request.size() > maxText) truncated.fetch_add(1, memory_order_relaxed);
+            while (!tryPush(request, timestamp)){
+                if (policy == LogOverflow::Drop){
+                    dropped.fetch_add(1, memory_order_relaxed);
+                    return false;
+                }
+                this_thread::yield();
+            }
+            logged.fetch_add(1, memory_order_relaxed);
+            return true;
+        }
+
+        size_t getLogged() const { return logged.load(); }
+        size_t getDropped() const { return dropped.load(); }
+        size_t getTruncated() const { return truncated.load(); }
+
+        static vector<string> read(const string& path){ //decodes a log file (tooling and tests)
+            vector<string> requests;
+            FILE* in = fopen(path.c_str(), "rb");
+            if (in == nullptr) return requests;
+            uint64_t timestamp;
+            uint16_t length;
+            char text[maxText];
+            while (fread(&timestamp, sizeof(timestamp), 1, in) == 1 && fread(&length, sizeof(length), 1, in) == 1 && length <= maxText && fread(text, 1, length, in) == length){
+                requests.emplace_back(text, length);
+            }
+            fclose(in);
+            return requests;
+        }
+};
+
+struct RequestLogOptions{ //where and how a Proxy logs its requests
+    string path;
+    size_t capacity = 4096;
+    LogOverflow policy = LogOverflow::Drop;
+};
+
+//Virtual proxy with a service pool: a Service is only built on the first request that really needs one (lazy), then kept warm and reused; concurrent requests get their own instance up to maxServices, and instances idle for longer than idleTimeout are released
+class ServicePool{
+    struct Idle{
+        unique_ptr<Service> service;
+        chrono::steady_clock::time_point since;
+    };
+    function<unique_ptr<Service>()> create; //how the pool brings a service up (the expensive part)
+    size_t maxServices;
+    chrono::milliseconds idleTimeout;
+    mutex m;
+    condition_variable available;
+    condition_variable reaperWake;
+    vector<Idle> idle; //most recently released at the back
+    size_t alive = 0; //idle + leased
+    size_t created = 0, reused = 0, evicted = 0;
+    bool stopping = false;
+    thread reaper; //releases idle services even when no request comes in
+
+    void evictIdle(chrono::steady_clock::time_point now){ //the oldest idle instances are at the front
+        size_t n = 0;
+        while (n < idle.size() && now - idle[n].since >= idleTimeout) n++;
+        idle.erase(idle.begin(), idle.begin() + n);
+        alive -= n;
+        evicted += n;
+    }
+
+    void release(unique_ptr<Service> s){
+        bool first;
+        {
+            lock_guard<mutex> lock(m);
+            auto now = chrono::steady_clock::now();
+            evictIdle(now);
+            idle.push_back(Idle{std::move(s), now});
+            first = idle.size() == 1;
+        }
+        available.notify_one();
+        if (first) reaperWake.notify_one(); //the reaper was waiting with nothing to evict
+    }
+
+    void reap(){ //sleeps until the oldest idle service times out
+        unique_lock<mutex> lock(m);
+        while (!stopping){
+            if (idle.empty()) reaperWake.wait(lock);
+            else reaperWake.wait_until(lock, idle.front().since + idleTimeout);
+            evictIdle(chrono::steady_clock::now());
+        }
+    }
+    public:
+        class Lease{ //gives the service back to the pool when it goes out of scope
+            ServicePool* pool;
+            unique_ptr<Service> service;
+            public:
+                Lease(ServicePool* p, unique_ptr<Service> s): pool(p), service(std::move(s)){}
+                Lease(Lease&&) = default;
+                ~Lease(){ if (service) pool->release(std::move(service)); }
+                Service* operator->() const { return service.get(); }
+                Service* get() const { return service.get(); }
+        };
+
+        using Factory = function<unique_ptr<Service>()>;
+
+        ServicePool(string n, int s, size_t maxS = 4, chrono::milliseconds timeout = chrono::seconds(30), Factory f = nullptr)
+            : create(f ? std::move(f) : Factory([n, s](){ return make_unique<Service>(n, s); })), maxServices(max<size_t>(1, maxS)), idleTimeout(timeout){
+            reaper = thread(&ServicePool::reap, this);
+        }
+
+        ~ServicePool(){ //every Lease must be returned before the pool goes away
+            {
+                lock_guard<mutex> lock(m);
+                stopping = true;
+            }
+            reaperWake.notify_one();
+            reaper.join();
+        }
+
+        Lease acquire(){ //warm instance if any, else a new one while under maxServices, else wait for a release
+            unique_lock<mutex> lock(m);
+            evictIdle(chrono::steady_clock::now());
+            available.wait(lock, [this](){ return !idle.empty() || alive < maxServices; });
+            if (!idle.empty()){
+                unique_ptr<Service> s = std::move(idle.back().service);
+                idle.pop_back();
+                reused++;
+                return Lease(this, std::move(s));
+            }
+            alive++;
+            created++;
+            lock.unlock(); //the (expensive) construction runs outside the lock
+            try {
+                return Lease(this, create());
+            } catch (...){
+                lock.lock();
+                alive--;
+                available.notify_one();
+                throw;
+            }
+        }
+
+        struct Stats{
+            size_t alive, idle, created, reused, evicted;
+        };
+        Stats getStats(){
+            lock_guard<mutex> lock(m);
+            evictIdle(chrono::steady_clock::now());
+            return Stats{alive, idle.size(), created, reused, evicted};
+        }
 };
+
+//Protection proxy: the service's credentials live in its proxy (the Service trusts whoever holds it) and users who passed the full check are remembered for a while
+///with digests precomputed, the local part of a check is one constantTimeEquals, cheaper than a cache lookup (hash, lock); the cache pays off only when the full check given to the verifier is expensive (a slow password hash, a call to an identity service)
+///one verifier per proxy, keyed by user name; sharded: each shard has its own lock, so concurrent users rarely contend; a ttl of 0 disables the cache
+class CredentialVerifier{
+    struct Entry{
+        CredentialDigest user;
+        chrono::steady_clock::time_point expiry;
+    };
+    struct alignas(64) Shard{ //one cache line per lock
+        mutex m;
+        unordered_map<string, Entry> verified;
+    };
+    static constexpr size_t shardCount = 16;
+    Shard shards[shardCount];
+    CredentialDigest expected;
+    function<bool(const CredentialDigest&, const CredentialDigest&)> check; //the full check: (presented, expected) -> accepted
+    chrono::milliseconds ttl;
+    atomic<size_t> hits{0};
+    atomic<size_t> misses{0};
+    atomic<size_t> failures{0};
+    atomic<uint64_t> verifyNanos{0}; //time spent in full checks
+
+    bool fullCheck(const CredentialDigest& presented){
+        auto start = chrono::steady_clock::now();
+        bool ok = check(presented, expected);
+        verifyNanos += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        return ok;
+    }
+    public:
+        using Check = function<bool(const CredentialDigest& presented, const CredentialDigest& expected)>;
+
+        CredentialVerifier(const CredentialDigest& e, chrono::milliseconds t = chrono::seconds(60), Check c = constantTimeEquals): expected(e), check(std::move(c)), ttl(t){}
+
+        bool verify(const string& user, const CredentialDigest& presented){
+            Shard& shard = shards[hash<string>{}(user) % shardCount];
+            auto now = chrono::steady_clock::now();
+            if (ttl.count() > 0){
+                lock_guard<mutex> lock(shard.m);
+                auto it = shard.verified.find(user);
+                if (it != shard.verified.end()){
+                    if (now < it->second.expiry && constantTimeEquals(it->second.user, presented)){
+                        hits++;
+                        return true;
+                    }
+                    shard.verified.erase(it); //expired, or the user's credentials changed since
+                }
+            }
+            misses++;
+            if (!fullCheck(presented)){ //failures are not cached: every wrong attempt pays the full check
+                failures++;
+                return false;
+            }
+            if (ttl.count() > 0){
+                lock_guard<mutex> lock(shard.m);
+                shard.verified[user] = Entry{presented, now + ttl};
+            }
+            return true;
+        }
+
+        void setExpected(const CredentialDigest& e){ //call before the verifier is shared between threads; forgets every verified user
+            expected = e;
+            for (Shard& shard: shards){
+                lock_guard<mutex> lock(shard.m);
+                shard.verified.clear();
+            }
+        }
+
+        struct Stats{
+            size_t hits, misses, failures;
+            double hitRate; //hits / checks
+            double averageVerifyUs; //per full check
+        };
+        Stats getStats() const {
+            size_t h = hits.load(), ms = misses.load();
+            return Stats{h, ms, failures.load(), h + ms > 0 ? double(h) / (h + ms) : 0.0, ms > 0 ? verifyNanos.load() / 1000.0 / ms : 0.0};
+        }
+};
+
 class Proxy: public ServiceInterface{ //only create a service object when needed -> it needs to implement the Service Interface to be able to disguise as a service to the User
     string name;
     int size;
-    vector<string> cachedResults; //caching proxy
-    vector<string> requestHistory; //logging proxy (logging requests: keeping a track of history of requests to the service object before processing)
+    ResultCache cachedResults; //caching proxy (keyed by request)
+    ServicePool services; //virtual proxy (services created on first need, then reused)
+    CredentialVerifier verifier; //protection proxy (holds the service's credentials, caches verified users)
+    unique_ptr<RequestLog> requestHistory; //logging proxy (logging requests: keeping a track of history of requests to the service object before processing)
+    mutex m; //guards the cache and the in-flight table: the proxy can be called from many threads
+    //request coalescing (single flight): concurrent misses on the same request wait for the one computation already in flight instead of each hitting the service (thundering herd)
+    unordered_map<string, shared_future<string>> inFlight;
+    atomic<size_t> computed{0}; //misses that reached the service
+    atomic<size_t> coalesced{0}; //misses served by another thread's computation
+
+    string compute(const string& request, const User& user){
+        ServicePool::Lease ser = services.acquire();// virtual proxy (lazy initialization and lifecycle control: only create the service object when needed for task delegation, then keep it warm) -> virtual proxy introduces concurrency (non-blocking I/O asynchronous execution: we don't wait for the service object to be available or ready e.g., cached results)
+        ser->processRequest(request, user); //remote proxy (service object located in a remote server -> local execution of remote service because the remote proxy handles all nasty details of working with an network)
+        computed++;
+        return ser->outputResult(request);
+    }
     public:
-        Proxy(string n, int s): name(n), size(s){}
-        bool verifyAccess(Service* s, string userCredentials){ //protection proxy (user credentials verification)
-            if (userCredentials == s->serviceCredentials) return true;
-            else return false;
+        //no request log: logging writes a file, so it is asked for explicitly through the RequestLogOptions constructor
+        Proxy(string n, int s, size_t cacheCapacity = 1024, EvictionPolicy policy = EvictionPolicy::LRU, chrono::milliseconds ttl = chrono::milliseconds(0), size_t maxServices = 4, chrono::milliseconds idleTimeout = chrono::seconds(30), ServicePool::Factory factory = nullptr)
+            : name(n), size(s), cachedResults(cacheCapacity, policy, ttl), services(n, s, maxServices, idleTimeout, std::move(factory)), verifier(hashCredentials("")){}
+
+        Proxy(string n, int s, const RequestLogOptions& log): Proxy(n, s){ //logging proxy: every request is appended to log.path
+            requestHistory = make_unique<RequestLog>(log.path, log.capacity, log.policy);
+        }
+        bool verifyAccess(const User& user){ //protection proxy (user credentials verification) -> checked before the cache, so cached results are protected too
+            return verifier.verify(user.getName(), user.getCredentialDigest());
+        }
+
+        void setServiceCredentials(const string& credentials){ //call before the proxy is shared between threads
+            verifier.setExpected(hashCredentials(credentials));
         }
 
         void processRequest(string request, const User& user) override{
-           Service* ser = new Service(name, size);// virtual proxy (lazy initialization and lifecycle control: only create the service object when needed for task delegation: make-to-order on the fly) -> virtual proxy introduces concurrency (non-blocking I/O asynchronous execution: we don't wait for the service object to be available or ready e.g., cached results)
-           requestHistory.push_back(request);//logging proxy (logging requests: keeping a track of history of requests to the service object before processing)
-           vector<string>::iterator it = find(cachedResults.begin(), cachedResults.end(), ser->outputResult(request)); //iterator type
-            if ( it != cachedResults.end()){ //cached results
-                int index = it - cachedResults.begin(); 
-                cout << cachedResults[index];
-            } else if (verifyAccess(ser,user.getCredentials())){
-                ser->processRequest(request, user); //remote proxy (service object located in a remote server -> local execution of remote service because the remote proxy handles all nasty details of working with an network)
-                string result = ser->outputResult(request);
-                cachedResults.push_back(result); //caching proxy (caching resource-consuming request results)
-            } else{
-                cout << "Service access invalid";
+            optional<string> result = fetch(request, user);
+            if (result) cout << *result;
+            else cout << "Service access invalid";
+        }
+
+        optional<string> fetch(const string& request, const User& user){ //thread-safe: access check, then cache, then in-flight computation, then the service
+            if (requestHistory) requestHistory->log(request);//logging proxy (logging requests: keeping a track of history of requests to the service object before processing) -> lock-free, outside the proxy lock
+            if (!verifyAccess(user)) return nullopt;
+            promise<string> leader;
+            shared_future<string> flight;
+            {
+                lock_guard<mutex> lock(m);
+                if (const string* cached = cachedResults.get(request)){ //cached results: the service is not touched at all
+                    return *cached;
+                }
+                auto it = inFlight.find(request);
+                if (it != inFlight.end()){
+                    flight = it->second;
+                } else {
+                    inFlight.emplace(request, leader.get_future().share());
+                }
+            }
+            if (flight.valid()){ //follower: wait for the leader's result
+                string shared = flight.get();
+                coalesced++;
+                return shared;
+            }
+            string result;
+            try {
+                result = compute(request, user);
+            } catch (...){
+                lock_guard<mutex> lock(m);
+                inFlight.erase(request);
+                leader.set_exception(current_exception());
+                throw;
             }
+            {
+                lock_guard<mutex> lock(m);
+                cachedResults.put(request, result); //caching proxy (caching resource-consuming request results)
+                inFlight.erase(request);
+            }
+            leader.set_value(result);
+            return result;
+        }
+
+        CacheStats getCacheStats(){
+            lock_guard<mutex> lock(m);
+            return cachedResults.getStats();
         }
+        const RequestLog* getRequestLog() const { return requestHistory.get(); }
+
+        ServicePool::Stats getPoolStats(){ return services.getStats(); }
+        CredentialVerifier::Stats getVerifierStats() const { return verifier.getStats(); }
+        size_t getComputedCount() const { return computed.load(); }
+        size_t getCoalescedCount() const { return coalesced.load(); }
 }; 
 
+//Remote proxy: requests go through a pluggable transport and return futures, so the caller does not block while the service works and can keep many requests in flight
+///InProcessTransport calls a local Service; UnixSocketTransport talks to a LoopbackServer hosting the Service behind a Unix domain socket (stand-in for a remote host)
+///wire format, both directions: uint32 request id, uint32 length, then the bytes; requests are pipelined on one connection and responses are matched back by id
+class ProxyTimeout: public runtime_error{
+    public:
+        ProxyTimeout(): runtime_error("proxy request timed out"){}
+};
 
-class Service: public ServiceInterface{
-    string name; 
-    string serviceCredentials;
+class ProxyTransport{
+    public:
+        using Completion = function<void(string result, exception_ptr error)>; //called exactly once, from whichever thread gets the response
+        virtual void send(string request, Completion done) = 0;
+        virtual ~ProxyTransport() = default;
+
+        future<string> call(string request){ //same request as a future
+            auto p = make_shared<promise<string>>();
+            future<string> result = p->get_future();
+            send(std::move(request), [p](string r, exception_ptr error){
+                if (error) p->set_exception(error);
+                else p->set_value(std::move(r));
+            });
+            return result;
+        }
+};
+
+class InProcessTransport: public ProxyTransport{
+    Service service;
+    mutex m; //Service is not thread-safe
+    public:
+        InProcessTransport(string n, int s): service(n, s){}
+
+        void send(string request, Completion done) override{ //runs on the caller's thread, done is called before send returns
+            string result;
+            try {
+                lock_guard<mutex> lock(m);
+                result = service.outputResult(request);
+            } catch (...){
+                done(string(), current_exception());
+                return;
+            }
+            done(std::move(result), nullptr);
+        }
+};
+
+#if defined(__unix__) || defined(__APPLE__)
+namespace wire{
+    inline bool writeAll(int fd, const char* data, size_t n){
+        while (n > 0){
+#ifdef MSG_NOSIGNAL
+            ssize_t k = ::send(fd, data, n, MSG_NOSIGNAL); //a closed peer is an error, not a SIGPIPE
+#else
+            ssize_t k = ::write(fd, data, n);
+#endif
+            if (k < 0 && errno == EINTR) continue;
+            if (k <= 0) return false;
+            data += k;
+            n -= static_cast<size_t>(k);
+        }
+        return true;
+    }
+
+    inline bool readAll(int fd, char* data, size_t n){
+        while (n > 0){
+            ssize_t k = ::read(fd, data, n);
+            if (k < 0 && errno == EINTR) continue;
+            if (k <= 0) return false;
+            data += k;
+            n -= static_cast<size_t>(k);
+        }
+        return true;
+    }
+
+    inline bool writeFrame(int fd, uint32_t id, string_view body){
+        string frame(8 + body.size(), '\0');
+        uint32_t length = static_cast<uint32_t>(body.size());
+        memcpy(&frame[0], &id, 4);
+        memcpy(&frame[4], &length, 4);
+        memcpy(&frame[8], body.data(), body.size());
+        return writeAll(fd, frame.data(), frame.size());
+    }
+
+    inline bool readFrame(int fd, uint32_t& id, string& body){
+        char header[8];
+        if (!readAll(fd, header, 8)) return false;
+        uint32_t length;
+        memcpy(&id, header, 4);
+        memcpy(&length, header + 4, 4);
+        body.resize(length);
+        return readAll(fd, &body[0], length);
+    }
+
+    inline sockaddr_un address(const string& path){
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) throw invalid_argument("socket path too long: " + path);
+        memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        return addr;
+    }
+}
+
+class LoopbackServer{ //hosts one Service per connection, answers requests in arrival order
+    string dir; //private directory (mode 0700, from mkdtemp) holding the socket: no other user can pre-create or take over the path
+    string path;
+    string name;
     int size;
+    int listenFd;
+    thread acceptor;
+    mutex m;
+    condition_variable closed;
+    unordered_map<int, thread> connections; //open connections by fd
+    vector<thread> finished; //connections that have returned, joined by the acceptor or the destructor
+
+    void serve(int fd){
+        {
+            Service service(name, size);
+            uint32_t id;
+            string request;
+            while (wire::readFrame(fd, id, request)){
+                if (!wire::writeFrame(fd, id, service.outputResult(request))) break;
+            }
+        }
+        lock_guard<mutex> lock(m); //hand this thread over for joining and give the fd back
+        auto it = connections.find(fd);
+        finished.push_back(std::move(it->second));
+        connections.erase(it);
+        ::close(fd);
+        closed.notify_all();
+    }
+
+    void joinFinished(){
+        vector<thread> done;
+        {
+            lock_guard<mutex> lock(m);
+            done.swap(finished);
+        }
+        for (thread& t: done) t.join();
+    }
+
+    void acceptLoop(){
+        while (true){
+            int fd = ::accept(listenFd, nullptr, nullptr);
+            if (fd < 0){
+                if (errno == EINTR) continue;
+                return; //listening socket closed
+            }
+            joinFinished();
+            lock_guard<mutex> lock(m);
+            connections[fd] = thread(&LoopbackServer::serve, this, fd); //serve cannot look itself up before the lock is released
+        }
+    }
     public:
-        Service(string n, int s): name(n), size(s){}
+        LoopbackServer(string n, int s): name(n), size(s){ //each server gets its own socket path, concurrent runs never collide
+            const char* tmp = getenv("TMPDIR");
+            string pattern = string(tmp && *tmp ? tmp : "/tmp") + "/proxy.XXXXXX";
+            if (!::mkdtemp(&pattern[0])) throw runtime_error("cannot create a socket directory in " + pattern);
+            dir = pattern;
+            path = dir + "/service.sock";
+            sockaddr_un addr = wire::address(path);
+            listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listenFd < 0 || ::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(listenFd, 64) < 0){
+                if (listenFd >= 0) ::close(listenFd);
+                ::unlink(path.c_str());
+                ::rmdir(dir.c_str());
+                throw runtime_error("cannot listen on " + path);
+            }
+            acceptor = thread(&LoopbackServer::acceptLoop, this);
+        }
+        LoopbackServer(const LoopbackServer&) = delete;
+        LoopbackServer& operator=(const LoopbackServer&) = delete;
+
+        ~LoopbackServer(){
+            ::shutdown(listenFd, SHUT_RDWR);
+            ::close(listenFd);
+            acceptor.join();
+            {
+                unique_lock<mutex> lock(m);
+                for (auto& c: connections) ::shutdown(c.first, SHUT_RDWR); //unblocks the readers
+                closed.wait(lock, [this](){ return connections.empty(); });
+            }
+            joinFinished();
+            ::unlink(path.c_str());
+            ::rmdir(dir.c_str());
+        }
 
-        void processRequest(string request, const User& user) override{
-            cout << user.getName() << "Request processed!";
+        const string& getPath() const { return path; }
+};
+
+class UnixSocketTransport: public ProxyTransport{
+    struct Pending{
+        Completion done;
+        chrono::steady_clock::time_point deadline;
+    };
+    int fd;
+    chrono::milliseconds timeout;
+    mutex writeMutex; //one frame at a time on the socket
+    mutex pendingMutex;
+    unordered_map<uint32_t, Pending> pending; //requests in flight on this connection
+    uint32_t nextId = 0;
+    bool closed = false; //set by the reader when the connection is gone
+    thread reader;
+
+    void expire(chrono::steady_clock::time_point now){
+        vector<Completion> expired;
+        {
+            lock_guard<mutex> lock(pendingMutex);
+            for (auto it = pending.begin(); it != pending.end();){
+                if (now >= it->second.deadline){
+                    expired.push_back(std::move(it->second.done));
+                    it = pending.erase(it); //a late response for this id is ignored
+                } else {
+                    ++it;
+                }
+            }
         }
+        for (Completion& done: expired) done(string(), make_exception_ptr(ProxyTimeout())); //outside the lock: done may send again
+    }
 
-        string outputResult(string request){
-            return request + "processed!"; 
+    void readLoop(){
+        uint32_t id;
+        string body;
+        while (true){
+            pollfd p{fd, POLLIN, 0};
+            int ready = ::poll(&p, 1, 10); //wakes up regularly to expire timed-out requests
+            expire(chrono::steady_clock::now());
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready == 0) continue;
+            if (ready < 0 || !wire::readFrame(fd, id, body)) break;
+            Completion done;
+            {
+                lock_guard<mutex> lock(pendingMutex);
+                auto it = pending.find(id);
+                if (it == pending.end()) continue;
+                done = std::move(it->second.done);
+                pending.erase(it);
+            }
+            done(std::move(body), nullptr);
+        }
+        unordered_map<uint32_t, Pending> left; //connection gone: fail what is left
+        {
+            lock_guard<mutex> lock(pendingMutex);
+            left.swap(pending);
+            closed = true;
+        }
+        for (auto& entry: left) entry.second.done(string(), make_exception_ptr(runtime_error("proxy connection closed")));
+    }
+    public:
+        UnixSocketTransport(const string& path, chrono::milliseconds t = chrono::seconds(5)): timeout(t){
+            sockaddr_un addr = wire::address(path);
+            fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0){
+                if (fd >= 0) ::close(fd);
+                throw runtime_error("cannot connect to " + path);
+            }
+            reader = thread(&UnixSocketTransport::readLoop, this);
         }
+        UnixSocketTransport(const UnixSocketTransport&) = delete;
+        UnixSocketTransport& operator=(const UnixSocketTransport&) = delete;
 
-        friend class Proxy; 
+        ~UnixSocketTransport(){
+            ::shutdown(fd, SHUT_RDWR);
+            reader.join();
+            ::close(fd);
+        }
+
+        void send(string request, Completion done) override{ //does not wait for the response: many requests can be in flight (pipelining)
+            uint32_t id = 0;
+            bool registered = false;
+            {
+                lock_guard<mutex> lock(pendingMutex);
+                if (!closed){
+                    id = nextId++;
+                    pending[id] = Pending{std::move(done), chrono::steady_clock::now() + timeout};
+                    registered = true;
+                }
+            }
+            if (!registered){ //the reader has already failed everything
+                done(string(), make_exception_ptr(runtime_error("proxy connection closed")));
+                return;
+            }
+            bool sent;
+            {
+                lock_guard<mutex> lock(writeMutex);
+                sent = wire::writeFrame(fd, id, request);
+            }
+            if (!sent){
+                Completion failed;
+                {
+                    lock_guard<mutex> lock(pendingMutex);
+                    auto it = pending.find(id);
+                    if (it == pending.end()) return; //already failed by the reader
+                    failed = std::move(it->second.done);
+                    pending.erase(it);
+                }
+                failed(string(), make_exception_ptr(runtime_error("proxy connection closed")));
+            }
+        }
 };
+#endif
+
+class AsyncProxy{ //remote proxy: the caller gets a future right away, the cache answers repeated requests without a round trip
+    ProxyTransport& transport;
+    mutex m;
+    condition_variable idle;
+    ResultCache cachedResults;
+    unordered_map<string, vector<promise<string>>> inFlight; //concurrent identical misses share one round trip
+    size_t roundTrips = 0;
+    size_t coalesced = 0;
+
+    void complete(const string& request, string result, exception_ptr error){ //called by the transport when the response (or a failure) arrives
+        vector<promise<string>> waiters;
+        {
+            lock_guard<mutex> lock(m);
+            auto it = inFlight.find(request);
+            waiters.swap(it->second);
+            inFlight.erase(it);
+            if (!error) cachedResults.put(request, result);
+            if (inFlight.empty()) idle.notify_all();
+        }
+        for (promise<string>& w: waiters){
+            if (error) w.set_exception(error);
+            else w.set_value(result);
+        }
+    }
+    public:
+        AsyncProxy(ProxyTransport& t, size_t cacheCapacity = 1024): transport(t), cachedResults(cacheCapacity){}
+        AsyncProxy(const AsyncProxy&) = delete;
+        AsyncProxy& operator=(const AsyncProxy&) = delete;
+
+        ~AsyncProxy(){ //the transport calls back into this proxy: wait for every request to complete or time out
+            unique_lock<mutex> lock(m);
+            idle.wait(lock, [this](){ return inFlight.empty(); });
+        }
+
+        future<string> processRequestAsync(const string& request){
+            future<string> result;
+            {
+                lock_guard<mutex> lock(m);
+                if (const string* cached = cachedResults.get(request)){
+                    promise<string> p;
+                    p.set_value(*cached);
+                    return p.get_future();
+                }
+                auto it = inFlight.find(request);
+                if (it != inFlight.end()){
+                    it->second.emplace_back();
+                    coalesced++;
+                    return it->second.back().get_future();
+                }
+                vector<promise<string>>& waiters = inFlight[request];
+                waiters.emplace_back();
+                result = waiters.back().get_future();
+                roundTrips++;
+            }
+            transport.send(request, [this, request](string r, exception_ptr error){ complete(request, std::move(r), error); }); //outside the lock: the in-process transport completes right here
+            return result;
+        }
+
+        string processRequest(const string& request){ //blocking convenience
+            return processRequestAsync(request).get();
+        }
+
+        size_t getRoundTrips(){
+            lock_guard<mutex> lock(m);
+            return roundTrips;
+        }
+        size_t getCoalescedCount(){
+            lock_guard<mutex> lock(m);
+            return coalesced;
+        }
+};
+
+//throughput: n distinct requests with up to `window` in flight, in-process vs loopback socket (window 1 = no pipelining)
+void benchAsyncProxy(int n){
+    auto run = [n](ProxyTransport& transport, size_t window){
+        deque<future<string>> inFlight;
+        size_t bytes = 0;
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < n; i++){
+            if (inFlight.size() == window){
+                bytes += inFlight.front().get().size();
+                inFlight.pop_front();
+            }
+            inFlight.push_back(transport.call("request " + to_string(i)));
+        }
+        for (future<string>& f: inFlight) bytes += f.get().size();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return bytes > 0 ? n / seconds : 0.0;
+    };
+    InProcessTransport local("Delivery", 20);
+    cout << "requests/s: in-process " << run(local, 1);
+#if defined(__unix__) || defined(__APPLE__)
+    LoopbackServer server("Delivery", 20);
+    UnixSocketTransport remote(server.getPath());
+    cout << ", loopback window 1 " << run(remote, 1) << ", loopback window 64 " << run(remote, 64);
+#endif
+    cout << "\n";
+}
+
+void User::chooseService(string name){ //one long-lived proxy per service name, shared by every user (instead of a new Proxy per call)
+    static mutex registryMutex;
+    static unordered_map<string, unique_ptr<Proxy>> proxies;
+    lock_guard<mutex> lock(registryMutex);
+    unique_ptr<Proxy>& p = proxies[name];
+    if (!p) p = make_unique<Proxy>(name, 20);
+    SI = p.get();
+}
+
+//request latency: a new Service per request (former behavior) vs the pool when cold (first request builds the service) and warm (reuse)
+///the construction cost is simulated by the factory the benchmark hands to the pool, Service itself has no timing hook
+void benchServicePool(int n, chrono::microseconds constructionCost){
+    auto slowStart = [constructionCost](){
+        this_thread::sleep_for(constructionCost);
+        return make_unique<Service>("Delivery", 20);
+    };
+    User guest("Guest", "");
+    streambuf* out = cout.rdbuf(nullptr);
+    auto time = [](auto&& f){
+        auto start = chrono::steady_clock::now();
+        f();
+        return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    };
+    double legacyUs = time([&](){
+        for (int i = 0; i < n; i++){
+            unique_ptr<Service> ser = slowStart();
+            ser->processRequest("request " + to_string(i), guest);
+            ser->outputResult("request " + to_string(i));
+        }
+    }) / n;
+    Proxy proxy("Delivery", 20, 1024, EvictionPolicy::LRU, chrono::milliseconds(0), 4, chrono::seconds(30), slowStart);
+    double coldUs = time([&](){ proxy.fetch("request cold", guest); });
+    double warmUs = time([&](){
+        for (int i = 0; i < n; i++) proxy.fetch("request " + to_string(i), guest); //distinct requests: every call reaches a service
+    }) / n;
+    cout.rdbuf(out);
+    cout.clear();
+    ServicePool::Stats st = proxy.getPoolStats();
+    cout << "latency: new Service per request " << legacyUs << " us, cold pool " << coldUs << " us, warm pool " << warmUs << " us (" << st.created << " created, " << st.reused << " reused)\n";
+}
+
+//access check cost: full check on every call (ttl 0) vs cached verified users, 4 threads over 64 users
+///with a free full check both cost about the same (a lookup vs one compare plus the timing of the check); the cache only wins when the full check is slow
+void benchCredentialVerification(int n, int rounds){
+    CredentialDigest expected = hashCredentials("abc");
+    vector<string> users;
+    for (int u = 0; u < 64; u++) users.push_back("user" + to_string(u));
+    CredentialDigest presented = hashCredentials("abc");
+    auto run = [&](CredentialVerifier& v){
+        auto start = chrono::steady_clock::now();
+        vector<thread> threads;
+        for (int t = 0; t < 4; t++){
+            threads.emplace_back([&, t](){
+                for (int i = t; i < n; i += 4) v.verify(users[i % users.size()], presented);
+            });
+        }
+        for (thread& th: threads) th.join();
+        return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / n;
+    };
+    auto stretch = [rounds](CredentialDigest d){ //key stretching (PBKDF-style): rehash the digest many times, a deliberately slow check
+        for (int r = 0; r < rounds; r++) d = hashCredentials(string_view(reinterpret_cast<const char*>(d.words), sizeof(d.words)));
+        return d;
+    };
+    CredentialVerifier::Check slowCheck = [&stretch](const CredentialDigest& p, const CredentialDigest& e){ return constantTimeEquals(stretch(p), stretch(e)); };
+    for (int slow = 0; slow < 2; slow++){
+        CredentialVerifier::Check check = slow ? slowCheck : CredentialVerifier::Check(constantTimeEquals);
+        CredentialVerifier uncached(expected, chrono::milliseconds(0), check);
+        CredentialVerifier cached(expected, chrono::seconds(60), check);
+        double uncachedUs = run(uncached);
+        double cachedUs = run(cached);
+        CredentialVerifier::Stats st = cached.getStats();
+        cout << "access check, " << (slow ? to_string(rounds) + "-round stretched hash" : string("plain compare")) << ": uncached " << uncachedUs << " us, cached " << cachedUs << " us (hit rate " << st.hitRate << ", " << st.averageVerifyUs << " us per full check)\n";
+    }
+}
 
 
 int main(){
     User us("Ayoub", "abc");
     us.chooseService("Delivery"); 
     us.makeRequest("I want to deliver my product!"); 
+
+    ResultCache lfu(2, EvictionPolicy::LFU);
+    lfu.put("a", "A");
+    lfu.put("b", "B");
+    lfu.get("a"); //a is now used twice
+    lfu.put("c", "C"); //evicts b (lowest frequency)
+    ResultCache lru(2, EvictionPolicy::LRU, chrono::milliseconds(500));
+    lru.put("a", "A");
+    lru.put("b", "B");
+    lru.get("a");
+    lru.put("c", "C"); //evicts b (least recently used)
+    const CacheStats& st = lfu.getStats();
+    cout << st.hits << " hits, " << st.misses << " misses, " << st.evictions << " evictions";
+
+    //many users sending the same request at the same moment: one computation, the others wait for it
+    Proxy shared("Delivery", 20, 1024, EvictionPolicy::LRU, chrono::milliseconds(0), 4, chrono::seconds(30), [](){ return make_unique<SlowService>("Delivery", 20, chrono::milliseconds(50)); });
+    User guest("Guest", ""); //matches the (empty) service credentials
+    vector<thread> users;
+    for (int k = 0; k < 8; k++){
+        users.emplace_back([&shared, &guest](){ shared.fetch("I want to deliver my product!", guest); });
+    }
+    for (thread& t: users) t.join();
+    cout << shared.getComputedCount() << " computed, " << shared.getCoalescedCount() << " coalesced";
+
+    benchServicePool(1000, chrono::microseconds(500));
+
+    string logPath = (filesystem::temp_directory_path() / ("delivery_requests." + to_string(random_device{}()) + ".log")).string();
+    {
+        Proxy logged("Delivery", 20, RequestLogOptions{logPath, 1024, LogOverflow::Drop});
+        for (int i = 0; i < 10000; i++) logged.fetch("request " + to_string(i % 100), guest);
+        cout << logged.getRequestLog()->getLogged() << " logged, " << logged.getRequestLog()->getDropped() << " dropped\n";
+    } //the log is flushed and closed here
+    cout << RequestLog::read(logPath).size() << " requests in the log file\n";
+    filesystem::remove(logPath);
+
+#if defined(__unix__) || defined(__APPLE__)
+    {
+        LoopbackServer server("Delivery", 20); //the "remote" service
+        UnixSocketTransport transport(server.getPath(), chrono::milliseconds(200));
+        AsyncProxy remote(transport);
+        future<string> a = remote.processRequestAsync("I want to deliver my product!");
+        future<string> b = remote.processRequestAsync("I want to store my product!"); //pipelined on the same connection
+        future<string> c = remote.processRequestAsync("I want to deliver my product!"); //joins the round trip of a
+        cout << a.get() << " " << b.get() << " " << c.get() << "\n";
+        remote.processRequestAsync("I want to store my product!").get(); //cached
+        cout << remote.getRoundTrips() << " round trips, " << remote.getCoalescedCount() << " coalesced\n";
+    }
+#endif
+    benchAsyncProxy(100000);
+
+    {
+        Proxy guarded("Delivery", 20);
+        guarded.setServiceCredentials("abc");
+        guarded.fetch("request 1", us); //full check
+        guarded.fetch("request 2", us); //cached
+        if (!guarded.fetch("request 3", guest)) cout << "Guest denied\n";
+        CredentialVerifier::Stats vs = guarded.getVerifierStats();
+        cout << vs.hits << " hits, " << vs.misses << " misses, " << vs.failures << " failures\n";
+    }
+    benchCredentialVerification(100000, 1000);
     return 0; 
 }
 
 
+
 //Behavioral Design Patterns: how objects communicate (information exchange mechanisms) and assign responsbilities to each others (delegation mechanisms)
 
 